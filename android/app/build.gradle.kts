@@ -37,6 +37,14 @@ android {
     }
 
     buildTypes {
+        debug {
+            // Native hot-path counters, read through NativeSolver.lastSolveStats()
+            externalNativeBuild {
+                cmake {
+                    arguments += "-DSOLVER_COUNTERS=ON"
+                }
+            }
+        }
         release {
             isMinifyEnabled = false
             signingConfig = signingConfigs.getByName("release")
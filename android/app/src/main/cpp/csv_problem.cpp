@@ -0,0 +1,169 @@
+#include "csv_problem.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+struct Openings {
+    std::vector<std::string> cp_names;
+    std::vector<int> slot_starts;
+    std::map<std::string, std::vector<int>> openings;
+};
+
+typedef std::map<std::pair<std::string, std::string>, std::pair<float, float>> Distances;
+
+std::vector<std::string> split_fields(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+        size_t first = field.find_first_not_of(" \t\r");
+        size_t last = field.find_last_not_of(" \t\r");
+        fields.push_back(first == std::string::npos ? "" : field.substr(first, last - first + 1));
+    }
+    if (!line.empty() && line.back() == ',') fields.push_back("");
+    return fields;
+}
+
+static bool is_blank(const std::string& s) {
+    return s.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+// Whole string as an int, or fallback.
+static int parse_int(const std::string& s, int fallback) {
+    char* end;
+    long v = strtol(s.c_str(), &end, 10);
+    return !s.empty() && *end == '\0' ? (int)v : fallback;
+}
+
+// Whole string as a float; false if it is not one.
+static bool parse_float(const std::string& s, float* out) {
+    char* end;
+    *out = strtof(s.c_str(), &end);
+    return !s.empty() && *end == '\0';
+}
+
+// Header: CP, BNG, 1000, 1030, ...; then one row per checkpoint.
+static bool read_openings(const char* path, Openings* out) {
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line)) {
+        fprintf(stderr, "Cannot read openings file %s\n", path);
+        return false;
+    }
+    if (line.compare(0, 3, "\xEF\xBB\xBF") == 0) line.erase(0, 3);
+
+    std::vector<std::string> header = split_fields(line);
+    for (size_t k = 2; k < header.size(); k++) {
+        const std::string& label = header[k];
+        if (label.size() < 3) {
+            fprintf(stderr, "Bad slot label '%s' in %s\n", label.c_str(), path);
+            return false;
+        }
+        int h = parse_int(label.substr(0, label.size() - 2), -1);
+        int m = parse_int(label.substr(label.size() - 2), -1);
+        if (h < 0 || m < 0) {
+            fprintf(stderr, "Bad slot label '%s' in %s\n", label.c_str(), path);
+            return false;
+        }
+        out->slot_starts.push_back(h * 60 + m);
+    }
+
+    while (std::getline(in, line)) {
+        if (is_blank(line)) continue;
+        std::vector<std::string> parts = split_fields(line);
+        if (parts.empty() || parts[0].empty()) continue;
+        std::vector<int> slots;
+        for (size_t k = 2; k < parts.size(); k++) slots.push_back(parse_int(parts[k], 0));
+        out->cp_names.push_back(parts[0]);
+        out->openings[parts[0]] = slots;
+    }
+    return true;
+}
+
+// Header, then StartCP, FinishCP, Distance, Height_Gain rows.
+static bool read_distances(const char* path, Distances* out) {
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line)) {
+        fprintf(stderr, "Cannot read distances file %s\n", path);
+        return false;
+    }
+    while (std::getline(in, line)) {
+        if (is_blank(line)) continue;
+        std::vector<std::string> parts = split_fields(line);
+        if (parts.size() < 4) continue;
+        float distance, height_gain;
+        if (!parse_float(parts[2], &distance) || !parse_float(parts[3], &height_gain)) continue;
+        (*out)[{parts[0], parts[1]}] = {distance, height_gain};
+    }
+    return true;
+}
+
+bool load_problem(const char* openings_path, const char* distances_path, SolverInput* full,
+                  std::vector<std::string>* names) {
+    Openings od;
+    Distances distances;
+    if (!read_openings(openings_path, &od) || !read_distances(distances_path, &distances)) {
+        return false;
+    }
+    if (od.slot_starts.empty()) {
+        fprintf(stderr, "No opening slots in %s\n", openings_path);
+        return false;
+    }
+
+    // Node layout: intermediates in file order, then Start and Finish
+    std::vector<std::string>& nodes = *names;
+    nodes.clear();
+    for (const std::string& name : od.cp_names) {
+        if (name != "Start" && name != "Finish") nodes.push_back(name);
+    }
+    int N = (int)nodes.size();
+    if (N < 1 || N > MAX_CP) {
+        fprintf(stderr, "Solver supports 1 to %d checkpoints, got %d in %s\n", MAX_CP, N,
+                openings_path);
+        return false;
+    }
+    nodes.push_back("Start");
+    nodes.push_back("Finish");
+
+    SolverInput& input = *full;
+    input = SolverInput();
+    input.n_checkpoints = N;
+    input.n_slots = (int)od.slot_starts.size();
+    input.slot_starts = od.slot_starts;
+    input.naismith = 10.0f;
+    input.start_time = 600;
+    input.end_time = 1020;
+    input.n_threads = 0;
+    input.open_at.assign((size_t)N * input.n_slots, 0);
+    for (int i = 0; i < N; i++) {
+        const std::vector<int>& slots = od.openings[nodes[i]];
+        for (int s = 0; s < input.n_slots && s < (int)slots.size(); s++) {
+            input.open_at[(size_t)i * input.n_slots + s] = slots[s] == 1;
+        }
+    }
+    input.finish_open.assign(input.n_slots, 0);
+    auto finish = od.openings.find("Finish");
+    if (finish != od.openings.end()) {
+        for (int s = 0; s < input.n_slots && s < (int)finish->second.size(); s++) {
+            input.finish_open[s] = finish->second[s] == 1;
+        }
+    }
+    int n_nodes = N + 2;
+    input.distance.assign((size_t)n_nodes * n_nodes, NAN);
+    input.height_gain.assign((size_t)n_nodes * n_nodes, 0.0f);
+    for (int i = 0; i < n_nodes; i++) {
+        for (int j = 0; j < n_nodes; j++) {
+            auto leg = distances.find({nodes[i], nodes[j]});
+            if (i == j || leg == distances.end()) continue;
+            input.distance[(size_t)i * n_nodes + j] = leg->second.first;
+            input.height_gain[(size_t)i * n_nodes + j] = leg->second.second;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Reads the app's checkpoint CSVs into a session problem for the host
+// tools. Files are read as CsvParser.kt reads them and the problem is laid
+// out as NativeSolver.kt lays it out, so results match the app's.
+
+#include "solver.h"
+
+#include <string>
+#include <vector>
+
+// Splits a CSV line on commas and trims each field.
+std::vector<std::string> split_fields(const std::string& line);
+
+// Builds a session problem over every checkpoint from an openings file
+// (CP, BNG, then one column per half-hour slot) and a distances file
+// (StartCP, FinishCP, Distance, Height_Gain). names gets the node names in
+// problem order, Start and Finish last. Timing fields are left at the
+// app's defaults: naismith 10, 10:00 to 17:00, one thread per core.
+// Returns false, having printed why, if either file is unusable.
+bool load_problem(const char* openings_path, const char* distances_path, SolverInput* full,
+                  std::vector<std::string>* names);
@@ -0,0 +1,327 @@
+// dovetrek-bench: times the solver core on every historical year with
+// every distance provider over a speed and dwell grid, then on synthetic
+// problems of growing size, and writes the results as JSON.
+//
+//   dovetrek-bench [options] > bench.json
+//
+// Each case reports the fastest and median wall time of its solve, the DP
+// passes and states behind it, the largest DP table and the process's
+// peak resident memory while it ran, plus the hot-path counters when the
+// core is built with SOLVER_COUNTERS. Compare two runs case by case; wall
+// times are only comparable on the same machine.
+
+#include "csv_problem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+namespace fs = std::filesystem;
+
+static const char* kUsage =
+    "usage: dovetrek-bench [options]\n"
+    "  --data DIR          directory holding CheckpointData and DataFrames (.)\n"
+    "  --speeds A,B,...    walking speeds for the historical years (4,5,6)\n"
+    "  --dwells A,B,...    dwell minutes for the historical years (5,7,10)\n"
+    "  --synthetic MIN MAX synthetic checkpoint counts, at 5 km/h and 7 min (10 24)\n"
+    "  --no-years          skip the historical years\n"
+    "  --no-synthetic      skip the synthetic problems\n"
+    "  --seed N            synthetic problem seed (1)\n"
+    "  --threads N         DP worker threads, 0 = one per core (0)\n"
+    "  --time-mode MODE    float or seconds (float)\n"
+    "  --repeat N          timed runs per case (3)\n";
+
+// Synthetic problems: checkpoints scattered over a square about as large
+// as a real course, with the app's 15 half-hour slots from 10:00.
+static const float SYNTHETIC_SIDE_KM = 6.0f;
+static const int SYNTHETIC_SLOTS = 15;
+static const int SYNTHETIC_FIRST_SLOT = 600;
+
+struct Case {
+    std::string kind;       // "year" or "synthetic"
+    std::string name;
+    int n_checkpoints;
+    float speed;
+    int dwell;
+    SolverResult result;
+    double min_ms;
+    double median_ms;
+    SolveStats stats;       // of one run
+    int64_t peak_rss_bytes; // -1 if unknown
+};
+
+// splitmix64: the same synthetic problems from a seed on every platform,
+// which <random>'s distributions do not promise.
+struct Rng {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1)
+    float unit() { return (float)(next() >> 40) / (float)(1 << 24); }
+};
+
+// N checkpoints at random points and heights, Start and Finish together
+// in the middle. Legs are 1.25 times the straight line with the climb to
+// the next point; each checkpoint slot is open with probability 3/4 and
+// Finish is always open.
+static SolverInput synthetic_problem(int N, uint64_t seed) {
+    Rng rng{seed * 1000003ull + (uint64_t)N};
+    int n_nodes = N + 2;
+    std::vector<float> x(n_nodes), y(n_nodes), height(n_nodes);
+    for (int i = 0; i < n_nodes; i++) {
+        bool hub = i >= N;
+        x[i] = hub ? 0.5f * SYNTHETIC_SIDE_KM : rng.unit() * SYNTHETIC_SIDE_KM;
+        y[i] = hub ? 0.5f * SYNTHETIC_SIDE_KM : rng.unit() * SYNTHETIC_SIDE_KM;
+        height[i] = hub ? 100.0f : rng.unit() * 200.0f;
+    }
+
+    SolverInput input;
+    input.n_checkpoints = N;
+    input.n_slots = SYNTHETIC_SLOTS;
+    for (int s = 0; s < SYNTHETIC_SLOTS; s++) input.slot_starts.push_back(SYNTHETIC_FIRST_SLOT + 30 * s);
+    input.naismith = 10.0f;
+    input.start_time = 600;
+    input.end_time = 1020;
+    input.n_threads = 0;
+    input.open_at.resize((size_t)N * SYNTHETIC_SLOTS);
+    for (uint8_t& open : input.open_at) open = rng.unit() < 0.75f;
+    input.finish_open.assign(SYNTHETIC_SLOTS, 1);
+    input.distance.assign((size_t)n_nodes * n_nodes, NAN);
+    input.height_gain.assign((size_t)n_nodes * n_nodes, 0.0f);
+    for (int i = 0; i < n_nodes; i++) {
+        for (int j = 0; j < n_nodes; j++) {
+            if (i == j) continue;
+            input.distance[(size_t)i * n_nodes + j] = 1.25f * std::hypot(x[j] - x[i], y[j] - y[i]);
+            input.height_gain[(size_t)i * n_nodes + j] = std::max(0.0f, height[j] - height[i]);
+        }
+    }
+    return input;
+}
+
+// Restarts the kernel's peak-RSS counter where it can be (Linux 4.0+);
+// elsewhere peaks are for the whole process so far.
+static void reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs) clear_refs << "5";
+}
+
+static int64_t peak_rss_bytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return atoll(line.c_str() + 6) * 1024;
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+// Solves one case `repeat` times on a session and workspace of its own.
+static Case run_case(const Session& session, float speed, int dwell, int time_mode, int repeat) {
+    Case c;
+    c.n_checkpoints = session_problem(session).n_checkpoints;
+    c.speed = speed;
+    c.dwell = dwell;
+
+    Workspace* ws = create_workspace();
+    reset_peak_rss();
+    std::vector<double> ms;
+    for (int r = 0; r < repeat; r++) {
+        reset_workspace_stats(ws);
+        auto t0 = std::chrono::steady_clock::now();
+        session_solve(session, &speed, 1, dwell, 0, time_mode, ENGINE_AUTO, ws, &c.result);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - t0;
+        ms.push_back(elapsed.count());
+    }
+    c.stats = workspace_stats(*ws);
+    c.peak_rss_bytes = peak_rss_bytes();
+    release_workspace(ws);
+
+    std::sort(ms.begin(), ms.end());
+    c.min_ms = ms.front();
+    c.median_ms = ms[ms.size() / 2];
+    return c;
+}
+
+static std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        if ((unsigned char)ch >= 0x20) out += ch;
+    }
+    return out + "\"";
+}
+
+static std::vector<float> parse_list(const char* s) {
+    std::vector<float> values;
+    for (const std::string& field : split_fields(s)) {
+        if (!field.empty()) values.push_back(strtof(field.c_str(), nullptr));
+    }
+    return values;
+}
+
+// Files in dir whose names start with prefix and end in .csv, sorted.
+static std::vector<fs::path> csv_files(const fs::path& dir, const std::string& prefix) {
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) == 0 && entry.path().extension() == ".csv") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+int main(int argc, char** argv) {
+    fs::path data = ".";
+    std::vector<float> speeds = {4.0f, 5.0f, 6.0f};
+    std::vector<float> dwells = {5.0f, 7.0f, 10.0f};
+    int synthetic_min = 10, synthetic_max = 24;
+    bool years = true, synthetic = true;
+    uint64_t seed = 1;
+    int threads = 0;
+    int time_mode = TIME_FLOAT;
+    int repeat = 3;
+
+    for (int a = 1; a < argc; a++) {
+        std::string opt = argv[a];
+        bool has_value = a + 1 < argc;
+        if (opt == "--data" && has_value) {
+            data = argv[++a];
+        } else if (opt == "--speeds" && has_value) {
+            speeds = parse_list(argv[++a]);
+        } else if (opt == "--dwells" && has_value) {
+            dwells = parse_list(argv[++a]);
+        } else if (opt == "--synthetic" && a + 2 < argc) {
+            synthetic_min = atoi(argv[++a]);
+            synthetic_max = atoi(argv[++a]);
+        } else if (opt == "--no-years") {
+            years = false;
+        } else if (opt == "--no-synthetic") {
+            synthetic = false;
+        } else if (opt == "--seed" && has_value) {
+            seed = strtoull(argv[++a], nullptr, 10);
+        } else if (opt == "--threads" && has_value) {
+            threads = atoi(argv[++a]);
+        } else if (opt == "--time-mode" && has_value) {
+            std::string mode = argv[++a];
+            if (mode == "float") time_mode = TIME_FLOAT;
+            else if (mode == "seconds") time_mode = TIME_SECONDS;
+            else {
+                fprintf(stderr, "Unknown time mode '%s'\n", mode.c_str());
+                return 2;
+            }
+        } else if (opt == "--repeat" && has_value) {
+            repeat = std::max(1, atoi(argv[++a]));
+        } else {
+            fprintf(stderr, "Unknown or incomplete option '%s'\n%s", opt.c_str(), kUsage);
+            return 2;
+        }
+    }
+    if (speeds.empty() || dwells.empty() || synthetic_min < 1 || synthetic_max > MAX_CP) {
+        fprintf(stderr, "Invalid grid or synthetic range\n");
+        return 2;
+    }
+
+    std::vector<Case> cases;
+
+    if (years) {
+        std::vector<fs::path> openings = csv_files(data / "CheckpointData", "Openings_");
+        std::vector<fs::path> providers = csv_files(data / "DataFrames", "Distances_");
+        if (openings.empty() || providers.empty()) {
+            fprintf(stderr, "No Openings_*.csv or Distances_*.csv under %s\n", data.string().c_str());
+            return 1;
+        }
+        for (const fs::path& year : openings) {
+            for (const fs::path& provider : providers) {
+                SolverInput input;
+                std::vector<std::string> nodes;
+                if (!load_problem(year.string().c_str(), provider.string().c_str(), &input, &nodes)) {
+                    continue;
+                }
+                input.n_threads = threads;
+                Session* session = create_session(std::move(input));
+                std::string name = year.stem().string() + " / " + provider.stem().string();
+                for (float speed : speeds) {
+                    for (float dwell : dwells) {
+                        Case c = run_case(*session, speed, (int)dwell, time_mode, repeat);
+                        c.kind = "year";
+                        c.name = name;
+                        fprintf(stderr, "%s at %.2f km/h, %d min: %.1f ms\n", name.c_str(),
+                                speed, (int)dwell, c.min_ms);
+                        cases.push_back(std::move(c));
+                    }
+                }
+                release_session(session);
+            }
+        }
+    }
+
+    if (synthetic) {
+        for (int N = synthetic_min; N <= synthetic_max; N++) {
+            SolverInput input = synthetic_problem(N, seed);
+            input.n_threads = threads;
+            Session* session = create_session(std::move(input));
+            Case c = run_case(*session, 5.0f, 7, time_mode, repeat);
+            c.kind = "synthetic";
+            c.name = "synthetic-" + std::to_string(N);
+            fprintf(stderr, "%s: %.1f ms\n", c.name.c_str(), c.min_ms);
+            cases.push_back(std::move(c));
+            release_session(session);
+        }
+    }
+
+    printf("{\n  \"threads\": %d,\n  \"time_mode\": %s,\n  \"repeat\": %d,\n  \"seed\": %llu,\n"
+           "  \"cases\": [\n", threads, time_mode == TIME_SECONDS ? "\"seconds\"" : "\"float\"",
+           repeat, (unsigned long long)seed);
+    for (size_t k = 0; k < cases.size(); k++) {
+        const Case& c = cases[k];
+        printf("    {\"kind\": %s, \"name\": %s, \"checkpoints\": %d, \"speed\": %.2f, "
+               "\"dwell\": %d, \"count\": %d, \"finish\": %.3f, \"min_ms\": %.3f, "
+               "\"median_ms\": %.3f, \"dp_passes\": %lld, \"states\": %lld, "
+               "\"table_bytes\": %zu, \"peak_rss_bytes\": %lld",
+               json_string(c.kind).c_str(), json_string(c.name).c_str(), c.n_checkpoints,
+               c.speed, c.dwell, c.result.count, c.result.finish_time, c.min_ms, c.median_ms,
+               (long long)c.stats.dp_passes, (long long)c.stats.states,
+               c.stats.peak_table_bytes, (long long)c.peak_rss_bytes);
+#ifdef SOLVER_COUNTERS
+        // Counters cover the last run only
+        const SolveCounters& n = c.stats.counters;
+        printf(", \"transitions\": %lld, \"past_end_time\": %lld, \"window_closed\": %lld, "
+               "\"finish_unreachable\": %lld, \"init_ms\": %.3f, \"layers_ms\": %.3f, "
+               "\"best_scan_ms\": %.3f, \"reconstruct_ms\": %.3f, \"reached\": [",
+               (long long)n.transitions, (long long)n.past_end_time, (long long)n.window_closed,
+               (long long)n.finish_unreachable, n.init_ms, n.layers_ms, n.best_scan_ms,
+               n.reconstruct_ms);
+        for (int pc = 1; pc <= c.n_checkpoints; pc++) {
+            printf("%s%lld", pc > 1 ? ", " : "", (long long)n.reached[pc]);
+        }
+        printf("]");
+#endif
+        printf("}%s\n", k + 1 < cases.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
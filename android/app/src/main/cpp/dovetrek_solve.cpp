@@ -0,0 +1,211 @@
+// dovetrek-solve: runs the solver core on the app's CSV files, for timing
+// and batch runs off-device.
+//
+//   dovetrek-solve OPENINGS.csv DISTANCES.csv [options]
+
+#include "csv_problem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const char* kUsage =
+    "usage: dovetrek-solve OPENINGS.csv DISTANCES.csv [options]\n"
+    "  --speed KMH         walking speed (5.3)\n"
+    "  --dwell MIN         minutes spent at each checkpoint (7)\n"
+    "  --naismith M        metres of climb per extra minute (10)\n"
+    "  --start TIME        start time, H:MM or minutes from midnight (10:00)\n"
+    "  --end TIME          latest finish, H:MM or minutes from midnight (17:00)\n"
+    "  --exclude A,B,...   checkpoints to leave out\n"
+    "  --threads N         DP worker threads, 0 = one per core (0)\n"
+    "  --time-mode MODE    float, seconds or verify (float)\n"
+    "  --engine NAME       auto, branch-bound or label-setting (auto)\n"
+    "  --frontier MIN MAX  list the speed steps between MIN and MAX instead\n"
+    "  --min-count N       lowest checkpoint count for --frontier (1)\n"
+    "  --repeat N          run N times and report the fastest (1)\n"
+    "  --budget MS         stop each run after MS milliseconds with the best so far\n"
+    "  -v                  log solver progress to stderr\n";
+
+// "H:MM" or plain minutes from midnight; -1 if neither.
+static int parse_time(const char* s) {
+    int h, m;
+    char extra;
+    if (sscanf(s, "%d:%d%c", &h, &m, &extra) == 2) return h * 60 + m;
+    char* end;
+    long minutes = strtol(s, &end, 10);
+    return *s != '\0' && *end == '\0' ? (int)minutes : -1;
+}
+
+static std::string format_time(float minutes) {
+    char buf[16];
+    int whole = (int)minutes;
+    snprintf(buf, sizeof buf, "%d:%02d", whole / 60, whole % 60);
+    return buf;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fputs(kUsage, stderr);
+        return 2;
+    }
+
+    float speed = 5.3f;
+    int dwell = 7;
+    float naismith = 10.0f;
+    int start_time = 600;
+    int end_time = 1020;
+    int threads = 0;
+    int time_mode = TIME_FLOAT;
+    int engine = ENGINE_AUTO;
+    std::set<std::string> excluded_names;
+    bool frontier = false;
+    float min_speed = 0.0f, max_speed = 0.0f;
+    int min_count = 1;
+    int repeat = 1;
+    double budget_ms = 0.0;
+    bool verbose = false;
+
+    for (int a = 3; a < argc; a++) {
+        std::string opt = argv[a];
+        bool has_value = a + 1 < argc;
+        if (opt == "-v") {
+            set_info_logging(true);
+            verbose = true;
+        } else if (opt == "--speed" && has_value) {
+            speed = strtof(argv[++a], nullptr);
+        } else if (opt == "--dwell" && has_value) {
+            dwell = atoi(argv[++a]);
+        } else if (opt == "--naismith" && has_value) {
+            naismith = strtof(argv[++a], nullptr);
+        } else if (opt == "--start" && has_value) {
+            start_time = parse_time(argv[++a]);
+        } else if (opt == "--end" && has_value) {
+            end_time = parse_time(argv[++a]);
+        } else if (opt == "--threads" && has_value) {
+            threads = atoi(argv[++a]);
+        } else if (opt == "--exclude" && has_value) {
+            for (const std::string& name : split_fields(argv[++a])) {
+                if (!name.empty()) excluded_names.insert(name);
+            }
+        } else if (opt == "--time-mode" && has_value) {
+            std::string mode = argv[++a];
+            if (mode == "float") time_mode = TIME_FLOAT;
+            else if (mode == "seconds") time_mode = TIME_SECONDS;
+            else if (mode == "verify") time_mode = TIME_VERIFY;
+            else {
+                fprintf(stderr, "Unknown time mode '%s'\n", mode.c_str());
+                return 2;
+            }
+        } else if (opt == "--engine" && has_value) {
+            std::string name = argv[++a];
+            if (name == "auto") engine = ENGINE_AUTO;
+            else if (name == "branch-bound") engine = ENGINE_BRANCH_BOUND;
+            else if (name == "label-setting") engine = ENGINE_LABEL_SETTING;
+            else {
+                fprintf(stderr, "Unknown engine '%s'\n", name.c_str());
+                return 2;
+            }
+        } else if (opt == "--frontier" && a + 2 < argc) {
+            frontier = true;
+            min_speed = strtof(argv[++a], nullptr);
+            max_speed = strtof(argv[++a], nullptr);
+        } else if (opt == "--min-count" && has_value) {
+            min_count = atoi(argv[++a]);
+        } else if (opt == "--repeat" && has_value) {
+            repeat = std::max(1, atoi(argv[++a]));
+        } else if (opt == "--budget" && has_value) {
+            budget_ms = strtod(argv[++a], nullptr);
+        } else {
+            fprintf(stderr, "Unknown or incomplete option '%s'\n%s", opt.c_str(), kUsage);
+            return 2;
+        }
+    }
+    if (!(speed > 0.0f) || dwell < 0 || start_time < 0 || end_time < start_time ||
+        (frontier && !(min_speed > 0.0f && max_speed >= min_speed))) {
+        fprintf(stderr, "Invalid speed, dwell or times\n");
+        return 2;
+    }
+
+    SolverInput input;
+    std::vector<std::string> nodes;
+    if (!load_problem(argv[1], argv[2], &input, &nodes)) return 1;
+    int N = input.n_checkpoints;
+
+    int excluded = 0;
+    for (const std::string& name : excluded_names) {
+        auto it = std::find(nodes.begin(), nodes.begin() + N, name);
+        if (it == nodes.begin() + N) {
+            fprintf(stderr, "Unknown checkpoint '%s'\n", name.c_str());
+            return 2;
+        }
+        excluded |= 1 << (int)(it - nodes.begin());
+    }
+
+    input.naismith = naismith;
+    input.start_time = start_time;
+    input.end_time = end_time;
+    input.n_threads = threads;
+
+    Session* session = create_session(std::move(input));
+    Workspace* ws = create_workspace();
+    set_solve_budget(ws, budget_ms);
+    if (verbose) {
+        set_solve_progress(ws, [](const SolveProgress& p) {
+            fprintf(stderr, "Layer %d of %d, best so far %d checkpoints\n", p.layer, p.n_layers,
+                    p.best_count);
+        });
+    }
+    double best_ms = INFINITY;
+    auto timed = [&](auto&& run) {
+        for (int r = 0; r < repeat; r++) {
+            auto t0 = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - t0;
+            best_ms = std::min(best_ms, elapsed.count());
+        }
+    };
+
+    if (frontier) {
+        std::vector<SpeedStep> steps;
+        timed([&] {
+            session_frontier(*session, min_speed, max_speed, min_count, dwell, excluded, ws, &steps);
+        });
+        printf("Speed steps between %.2f and %.2f km/h, dwell %d min:\n", min_speed, max_speed, dwell);
+        for (const SpeedStep& step : steps) {
+            printf("  %.6f km/h: %d checkpoints, finish %s, route", step.speed,
+                   step.result.count, format_time(step.result.finish_time).c_str());
+            for (int cp : step.result.route) printf(" %s", nodes[cp].c_str());
+            printf("\n");
+        }
+    } else {
+        SolverResult result;
+        std::vector<Stop> timeline;
+        timed([&] {
+            session_solve(*session, &speed, 1, dwell, excluded, time_mode, engine, ws, &result,
+                          &timeline);
+        });
+        printf("Speed %.2f km/h, dwell %d min: %d checkpoints", speed, dwell, result.count);
+        if (result.count > 0) printf(", finish %s (%.3f)", format_time(result.finish_time).c_str(),
+                                     result.finish_time);
+        printf("\n");
+        if (result.count_bound > result.count) {
+            printf("Not proven: a route may visit up to %d checkpoints\n", result.count_bound);
+        }
+        for (const Stop& stop : timeline) {
+            printf("  %-10s arrive %-6s depart %s\n", nodes[stop.node].c_str(),
+                   format_time(stop.arrival).c_str(), format_time(stop.depart).c_str());
+        }
+    }
+    if (solve_stopped(*ws)) printf("Stopped early: the budget ran out\n");
+    printf("Solve time: %.1f ms%s\n", best_ms, repeat > 1 ? " (fastest run)" : "");
+
+    release_workspace(ws);
+    release_session(session);
+    return 0;
+}
@@ -1,48 +1,69 @@
-#include <jni.h>
-#include <android/log.h>
+#include "solver.h"
+#include "solver_log.h"
+
 #include <cmath>
 #include <cstring>
 #include <vector>
 #include <algorithm>
 #include <cfloat>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 
-#define LOG_TAG "RouteSolver"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-
-static const int MAX_CP = 17;
-static const int MAX_SLOTS = 15;
-static const int ALL_NODES = 19; // 17 intermediates + Start(17) + Finish(18)
-static const int START_IDX = 17;
-static const int FINISH_IDX = 18;
-static const float INF_TIME = 1e9f;
+#if defined(__unix__)
+#include <unistd.h>
+#endif
 
-struct SolverInput {
-    int n_checkpoints;          // 17
-    int n_slots;                // 15
-    float travel_time[ALL_NODES][ALL_NODES];
-    bool open_at[MAX_CP][MAX_SLOTS];   // intermediate CP openings
-    bool finish_open[MAX_SLOTS];       // Finish openings
-    int slot_starts[MAX_SLOTS];        // slot start times in minutes
-    float speed;
-    int dwell;                  // 7
-    float naismith;             // 10.0
-    int start_time;             // 600
-    int end_time;               // 1020
-};
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
-struct SolverResult {
-    int count;                  // checkpoints visited
-    int route[MAX_CP];          // CP indices in order
-    int route_length;
-    float finish_time;          // in minutes from midnight
-};
+static const float INF_TIME = 1e9f;
+// Widest vector the pull kernels use (AVX2: 8 floats); per-target leg
+// columns are padded to a multiple of it.
+static const int SIMD_WIDTH = 8;
+static const int MAX_STRIDE = (MAX_CP + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+// Batched solves: lanes per pass (one bit each in the frontier bytes), and
+// the dp states one pass may allocate before lanes are split across passes.
+static const int MAX_LANES = 8;
+static const size_t BATCH_STATES = (size_t)1 << 24;
+// Largest DP table a Workspace keeps between solves; anything bigger is
+// freed once its solve returns.
+static const size_t WORKSPACE_RETAIN_BYTES = (size_t)64 << 20;
+// A DP pass stores only the masks it reaches while they number under one
+// in SPARSE_MASK_DIVISOR of the lattice, then moves to a dense table.
+static const size_t SPARSE_MASK_DIVISOR = 8;
+// Dense tables bigger than the last-level cache keep each popcount layer
+// contiguous; this stands in for systems that do not report their caches.
+static const size_t DEFAULT_CACHE_BYTES = (size_t)4 << 20;
 
 // Count set bits (popcount)
 static inline int popcount(int x) {
-    int c = 0;
-    while (x) { c += x & 1; x >>= 1; }
-    return c;
+    return __builtin_popcount((unsigned)x);
+}
+
+// Next larger mask with the same popcount (Gosper's hack). Walking a layer
+// with it visits masks in increasing order.
+static inline int next_combination(int mask) {
+    int low = mask & -mask;
+    int ripple = mask + low;
+    return (((ripple ^ mask) >> 2) / low) | ripple;
+}
+
+// The mask after `mask` in popcount then increasing order over n bits,
+// the order of DP table slots.
+static inline int next_layered_mask(int mask, int n) {
+    if (mask == 0) return 1;
+    int next = next_combination(mask);
+    return next >> n ? (1 << (popcount(mask) + 1)) - 1 : next;
 }
 
 // Convert arrival time (minutes from midnight) to slot index.
@@ -72,7 +93,7 @@ static float find_next_open_time(int cp_idx, float arrival_minutes, const Solver
     int slot = arrival_to_slot_index(arrival_minutes, input);
     if (slot < 0) slot = 0;
     for (int s = slot; s < input->n_slots; s++) {
-        if (input->open_at[cp_idx][s]) {
+        if (input->is_open(cp_idx, s)) {
             float t = arrival_minutes > (float)input->slot_starts[s]
                       ? arrival_minutes : (float)input->slot_starts[s];
             return t;
@@ -81,280 +102,3010 @@ static float find_next_open_time(int cp_idx, float arrival_minutes, const Solver
     return -1.0f;
 }
 
-// Check if we can reach Finish from current_idx within an open Finish window.
-static bool can_reach_finish(float current_time, int current_idx, const SolverInput* input) {
-    float t_to_finish = input->travel_time[current_idx][FINISH_IDX];
-    float finish_arrival = current_time + t_to_finish;
+// Time at which a team arriving at Finish at finish_arrival is checked in:
+// the arrival itself, or the start of the next open Finish slot. Returns
+// -1.0f if Finish does not open again by end_time.
+static float find_finish_time(float finish_arrival, const SolverInput* input) {
     if (finish_arrival > (float)input->end_time) {
-        return false;
+        return -1.0f;
     }
     int slot = arrival_to_slot_index(finish_arrival, input);
     if (slot < 0 || slot >= input->n_slots) {
-        return false;
+        return -1.0f;
     }
     for (int s = slot; s < input->n_slots; s++) {
         if (input->finish_open[s]) {
             float wait_until = finish_arrival > (float)input->slot_starts[s]
                                ? finish_arrival : (float)input->slot_starts[s];
-            if (wait_until <= (float)input->end_time) {
-                return true;
-            }
+            return wait_until <= (float)input->end_time ? wait_until : -1.0f;
         }
     }
-    return false;
+    return -1.0f;
 }
 
-// Main bitmask DP solver.
-static void solve(SolverInput* input, SolverResult* result) {
+// Walking time in minutes for one leg, as NativeSolver.kt computes it:
+// distance at speed plus Naismith's allowance for climb. The sum is a
+// separate statement so it cannot be contracted into an FMA and drift
+// from the Kotlin value.
+static inline float travel_minutes(float distance, float height_gain, float speed, float naismith) {
+    float walk = (distance / speed) * 60.0f;
+    float climb = height_gain / naismith;
+    return walk + climb;
+}
+
+// Rebuild travel_time from distance and height_gain at a new speed: one
+// branch-free pass over the whole matrix, which the compiler vectorises,
+// then FLT_MAX on the diagonal. Missing legs have a NaN distance and also
+// become FLT_MAX.
+static void set_speed(SolverInput* input, float speed) {
+    int nNodes = input->n_nodes();
+    size_t n = (size_t)nNodes * nNodes;
+    input->speed = speed;
+    input->travel_time.resize(n);
+    const float* distance = input->distance.data();
+    const float* height_gain = input->height_gain.data();
+    float* travel = input->travel_time.data();
+    float naismith = input->naismith;
+    for (size_t k = 0; k < n; k++) {
+        float t = travel_minutes(distance[k], height_gain[k], speed, naismith);
+        travel[k] = distance[k] == distance[k] ? t : FLT_MAX;
+    }
+    for (int i = 0; i < nNodes; i++) {
+        travel[(size_t)i * nNodes + i] = FLT_MAX;
+    }
+}
+
+// Earliest-open lookup: for every intermediate CP and every whole arrival
+// minute in [base, end_time], the start of the first open slot at or after
+// that minute's slot (INF_TIME if none). Slot membership only depends on the
+// whole minute, so max(arrival, next_open[minute]) reproduces
+// find_next_open_time() exactly with a single indexed load.
+struct OpenTable {
+    int base;                       // first minute covered
+    int span;                       // minutes per row (base .. end_time)
+    float end_time;
+    std::vector<float> next_open;   // N x span
+    std::vector<float> finish_next; // span, Finish check-in time per arrival minute
+    float latest_finish_arrival;    // last arrival that still finds Finish open
+};
+
+static void build_open_table(const SolverInput* input, OpenTable* table) {
     int N = input->n_checkpoints;
-    int total_states = (1 << N) * N;
+    // Arrivals before slot 0 all share slot 0's entry, so start the table no
+    // later than the first slot.
+    table->base = std::min(input->start_time, input->slot_starts[0]);
+    table->span = std::max(input->end_time - table->base + 1, 1);
+    table->end_time = (float)input->end_time;
+    table->next_open.assign((size_t)N * table->span, INF_TIME);
+    for (int j = 0; j < N; j++) {
+        float* row = &table->next_open[(size_t)j * table->span];
+        for (int w = 0; w < table->span; w++) {
+            float t = find_next_open_time(j, (float)(table->base + w), input);
+            if (t >= 0.0f) row[w] = t;
+        }
+    }
 
-    LOGI("Solving: N=%d, speed=%.2f, states=%d", N, input->speed, total_states);
+    // Finish row. Whether an arrival is accepted also depends only on its
+    // whole minute, and with contiguous slots the accepted minutes form a
+    // prefix, so one latest-arrival bound captures the whole check.
+    table->finish_next.assign(table->span, INF_TIME);
+    table->latest_finish_arrival = -INF_TIME;
+    for (int w = 0; w < table->span; w++) {
+        float t = find_finish_time((float)(table->base + w), input);
+        if (t < 0.0f) continue;
+        table->finish_next[w] = t;
+        // Every arrival in [minute, minute + 1) is accepted, up to end_time
+        float next_minute = (float)(table->base + w + 1);
+        table->latest_finish_arrival = next_minute > table->end_time
+            ? table->end_time : std::nextafter(next_minute, -INFINITY);
+    }
+}
 
-    // Allocate DP arrays
-    std::vector<float> dp(total_states, INF_TIME);
-    // parent encoding: -1 = no parent, otherwise packed as (prev_mask << 5) | prev_pos
-    // But mask can be up to 2^17, so we need 17+5=22 bits. Use int32.
-    // Pack as: prev_pos in low 5 bits, prev_mask in upper bits. -1 = from Start.
-    std::vector<int> parent(total_states, -2); // -2 = unvisited, -1 = from Start
+// Largest t such that t + offset <= limit in float arithmetic. Float addition
+// is monotone, so every t up to the result passes the same test exactly.
+static float latest_start(float offset, float limit) {
+    float t = limit - offset;
+    while (t + offset > limit) t = std::nextafter(t, -INFINITY);
+    for (float up = std::nextafter(t, INFINITY); up + offset <= limit;
+         up = std::nextafter(up, INFINITY)) {
+        t = up;
+    }
+    return t;
+}
 
-    auto idx = [&](int mask, int pos) -> int {
-        return mask * N + pos;
-    };
+// Latest safe departure from each intermediate CP: leaving at or before
+// depart_limit[i] reaches an open Finish window by end_time, and the limit
+// is itself no later than end_time. Departures from checkpoints are never
+// earlier than slot 0, so Finish is never reached before its first slot.
+static void build_depart_limits(const SolverInput* input, const OpenTable& table,
+                                std::vector<float>* depart_limit) {
+    int N = input->n_checkpoints;
+    depart_limit->resize(N);
+    for (int i = 0; i < N; i++) {
+        float limit = latest_start(input->tt(i, input->finish_idx()), table.latest_finish_arrival);
+        (*depart_limit)[i] = std::min(limit, table.end_time);
+    }
+}
 
-    float depart_start = (float)input->start_time;
+// Transfer function of one DP edge (i -> j): departing i at or before
+// depart_limit arrives at j after `travel` and can leave j in time to reach
+// Finish; any later departure is infeasible. Time-dependent legs would only
+// change how these fields are built, not the DP kernel.
+struct Leg {
+    float travel;
+    float depart_limit;
+};
 
-    // Initialize: Start -> each intermediate CP
+// Per-solve transfer tables. legs is (N+1) x N: rows are intermediates then
+// Start, columns are intermediates. ready[j][minute] is when j can be left
+// after arriving during that minute: next opening plus dwell, or at least
+// INF_TIME if it never reopens. in_travel/in_limit hold the same legs
+// transposed, one padded column per target, for the vector pull kernels.
+struct LegTable {
+    int n_checkpoints;
+    int base;
+    int span;
+    int stride;                 // N rounded up to SIMD_WIDTH
+    float dwell;
+    std::vector<Leg> legs;
+    std::vector<float> ready;   // N x span
+    std::vector<float> arrival_limit;   // N, latest feasible arrival at each target
+    std::vector<float> in_travel;   // N x stride, [j][i] = legs(i -> j).travel
+    std::vector<float> in_limit;    // N x stride, -inf in padding lanes
+
+    const Leg& leg(int from, int to) const { return legs[(size_t)from * n_checkpoints + to]; }
+};
+
+// Folds travel, the end-time check, waiting for the window, dwell and the
+// Finish deadline into one Leg per edge. Leaving j after arriving at `a` is
+// max(a + dwell, ready[j][minute(a)]), which is non-decreasing in a, so the
+// feasible arrivals at j are everything up to one bound and the feasible
+// departures from i follow through latest_start().
+static void build_leg_table(const SolverInput* input, const OpenTable& table,
+                            const std::vector<float>& depart_limit, LegTable* lt) {
+    int N = input->n_checkpoints;
+    lt->n_checkpoints = N;
+    lt->base = table.base;
+    lt->span = table.span;
+    lt->dwell = (float)input->dwell;
+    lt->ready.resize((size_t)N * table.span);
+    for (size_t k = 0; k < lt->ready.size(); k++) {
+        lt->ready[k] = table.next_open[k] + lt->dwell;
+    }
+
+    std::vector<float>& arrival_limit = lt->arrival_limit;
+    arrival_limit.resize(N);
     for (int j = 0; j < N; j++) {
-        float arr = depart_start + input->travel_time[START_IDX][j];
-        float open_time = find_next_open_time(j, arr, input);
-        if (open_time < 0.0f) continue;
-        float depart_j = open_time + (float)input->dwell;
-        if (depart_j > (float)input->end_time) continue;
-        if (!can_reach_finish(depart_j, j, input)) continue;
+        const float* row = &lt->ready[(size_t)j * table.span];
+        float limit = depart_limit[j];
+        int last = -1;
+        for (int w = 0; w < table.span; w++) {
+            if (row[w] <= limit) last = w;
+        }
+        if (last < 0) {
+            arrival_limit[j] = -INF_TIME;
+            continue;
+        }
+        float next_minute = (float)(table.base + last + 1);
+        float by_window = next_minute > table.end_time
+            ? table.end_time : std::nextafter(next_minute, -INFINITY);
+        arrival_limit[j] = std::min(by_window, latest_start(lt->dwell, limit));
+    }
 
-        int mask = 1 << j;
-        int si = idx(mask, j);
-        if (depart_j < dp[si]) {
-            dp[si] = depart_j;
-            parent[si] = -1; // came from Start
+    lt->legs.resize((size_t)(N + 1) * N);
+    for (int i = 0; i <= N; i++) {
+        int from = i < N ? i : input->start_idx();
+        for (int j = 0; j < N; j++) {
+            Leg& leg = lt->legs[(size_t)i * N + j];
+            leg.travel = input->tt(from, j);
+            leg.depart_limit = latest_start(leg.travel, arrival_limit[j]);
         }
     }
 
-    // Group masks by popcount and process in order
-    // We process popcount 1..N
-    // For efficiency, collect masks that have valid dp entries
-    std::vector<std::vector<int>> masks_by_pc(N + 1);
+    lt->stride = (N + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    lt->in_travel.assign((size_t)N * lt->stride, 0.0f);
+    lt->in_limit.assign((size_t)N * lt->stride, -INFINITY);
     for (int j = 0; j < N; j++) {
-        int mask = 1 << j;
-        int si = idx(mask, j);
-        if (dp[si] < INF_TIME) {
-            masks_by_pc[1].push_back(mask);
+        for (int i = 0; i < N; i++) {
+            lt->in_travel[(size_t)j * lt->stride + i] = lt->leg(i, j).travel;
+            lt->in_limit[(size_t)j * lt->stride + i] = lt->leg(i, j).depart_limit;
         }
     }
-    // Remove duplicates in masks_by_pc[1]
-    std::sort(masks_by_pc[1].begin(), masks_by_pc[1].end());
-    masks_by_pc[1].erase(std::unique(masks_by_pc[1].begin(), masks_by_pc[1].end()),
-                         masks_by_pc[1].end());
+}
 
-    // Main DP loop
-    for (int pc = 1; pc < N; pc++) {
-        for (int mask : masks_by_pc[pc]) {
-            for (int i = 0; i < N; i++) {
-                if (!(mask & (1 << i))) continue;
-                int si = idx(mask, i);
-                if (dp[si] >= INF_TIME) continue;
-                float depart_i = dp[si];
-
-                // Try extending to each unvisited CP
-                for (int j = 0; j < N; j++) {
-                    if (mask & (1 << j)) continue;
-                    float arr_j = depart_i + input->travel_time[i][j];
-                    if (arr_j > (float)input->end_time) continue;
-                    float open_time = find_next_open_time(j, arr_j, input);
-                    if (open_time < 0.0f) continue;
-                    float depart_j = open_time + (float)input->dwell;
-                    if (depart_j > (float)input->end_time) continue;
-                    if (!can_reach_finish(depart_j, j, input)) continue;
-
-                    int new_mask = mask | (1 << j);
-                    int new_si = idx(new_mask, j);
-                    if (depart_j < dp[new_si]) {
-                        dp[new_si] = depart_j;
-                        // Pack parent: (mask << 5) | i
-                        parent[new_si] = (mask << 5) | i;
-
-                        // Register new_mask in next popcount bucket
-                        int npc = pc + 1;
-                        // We'll deduplicate later
-                        masks_by_pc[npc].push_back(new_mask);
-                    }
-                }
-            }
+// Departure time from j for a feasible arrival there.
+static inline float leave_after(const LegTable& lt, int j, float arrival) {
+    float ready = lt.ready[(size_t)j * lt.span + ((int)arrival - lt.base)];
+    float walk_in = arrival + lt.dwell;
+    return walk_in > ready ? walk_in : ready;
+}
+
+// Departure time from j after walking leg (i -> j) from depart_i, or
+// INF_TIME if the leg is infeasible. Start is row N.
+static inline float take_leg(const LegTable& lt, int i, int j, float depart_i) {
+    const Leg& leg = lt.leg(i, j);
+    if (depart_i > leg.depart_limit) return INF_TIME;
+    return leave_after(lt, j, depart_i + leg.travel);
+}
+
+// ── Pull kernels ────────────────────────────────────────────────────
+//
+// A pull kernel takes the dp row of a predecessor mask and a target j, and
+// returns the lowest i whose state (prev, i) gives the earliest departure
+// from j, storing that departure in *best; -1 if no leg is feasible. Row
+// entries for i outside prev are INF_TIME and padding lanes have a -inf
+// limit, so every lane can be evaluated without masking.
+//
+// The vector kernels only compute arrivals (t + travel, or INF_TIME for
+// infeasible lanes) and their minimum. Leaving j is non-decreasing in the
+// arrival, so the minimum arrival gives the best departure; the lowest lane
+// that leaves at that same time is then found by a short scalar scan.
+typedef int (*PullKernel)(const LegTable& lt, const float* prev_row, int j, float* best);
+
+__attribute__((unused))
+static int pull_scalar(const LegTable& lt, const float* prev_row, int j, float* best) {
+    const float* travel = &lt.in_travel[(size_t)j * lt.stride];
+    const float* limit = &lt.in_limit[(size_t)j * lt.stride];
+    float best_depart = INF_TIME;
+    int best_i = -1;
+    for (int i = 0; i < lt.n_checkpoints; i++) {
+        if (prev_row[i] > limit[i]) continue;
+        float depart_j = leave_after(lt, j, prev_row[i] + travel[i]);
+        if (depart_j < best_depart) {
+            best_depart = depart_j;
+            best_i = i;
+        }
+    }
+    *best = best_depart;
+    return best_i;
+}
+
+static inline int first_lane_leaving_at(const LegTable& lt, int j, const float* arrivals,
+                                        float min_arrival, float* best) {
+    float target = leave_after(lt, j, min_arrival);
+    int i = 0;
+    while (arrivals[i] + lt.dwell > target || leave_after(lt, j, arrivals[i]) != target) i++;
+    *best = target;
+    return i;
+}
+
+#if defined(__x86_64__)
+static int pull_sse2(const LegTable& lt, const float* prev_row, int j, float* best) {
+    const float* travel = &lt.in_travel[(size_t)j * lt.stride];
+    const float* limit = &lt.in_limit[(size_t)j * lt.stride];
+    alignas(32) float arrivals[MAX_STRIDE];
+    const __m128 inf = _mm_set1_ps(INF_TIME);
+    __m128 lo = inf;
+    for (int i = 0; i < lt.stride; i += 4) {
+        __m128 t = _mm_loadu_ps(prev_row + i);
+        __m128 ok = _mm_cmple_ps(t, _mm_loadu_ps(limit + i));
+        __m128 a = _mm_add_ps(t, _mm_loadu_ps(travel + i));
+        a = _mm_or_ps(_mm_and_ps(ok, a), _mm_andnot_ps(ok, inf));
+        _mm_store_ps(arrivals + i, a);
+        lo = _mm_min_ps(lo, a);
+    }
+    lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    float min_arrival = _mm_cvtss_f32(lo);
+    if (min_arrival >= INF_TIME) return -1;
+    return first_lane_leaving_at(lt, j, arrivals, min_arrival, best);
+}
+
+__attribute__((target("avx2")))
+static int pull_avx2(const LegTable& lt, const float* prev_row, int j, float* best) {
+    const float* travel = &lt.in_travel[(size_t)j * lt.stride];
+    const float* limit = &lt.in_limit[(size_t)j * lt.stride];
+    alignas(32) float arrivals[MAX_STRIDE];
+    const __m256 inf = _mm256_set1_ps(INF_TIME);
+    __m256 lo = inf;
+    for (int i = 0; i < lt.stride; i += 8) {
+        __m256 t = _mm256_loadu_ps(prev_row + i);
+        __m256 ok = _mm256_cmp_ps(t, _mm256_loadu_ps(limit + i), _CMP_LE_OQ);
+        __m256 a = _mm256_add_ps(t, _mm256_loadu_ps(travel + i));
+        a = _mm256_blendv_ps(inf, a, ok);
+        _mm256_store_ps(arrivals + i, a);
+        lo = _mm256_min_ps(lo, a);
+    }
+    __m128 half = _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1));
+    half = _mm_min_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+    float min_arrival = _mm_cvtss_f32(half);
+    if (min_arrival >= INF_TIME) return -1;
+    return first_lane_leaving_at(lt, j, arrivals, min_arrival, best);
+}
+#elif defined(__aarch64__)
+static int pull_neon(const LegTable& lt, const float* prev_row, int j, float* best) {
+    const float* travel = &lt.in_travel[(size_t)j * lt.stride];
+    const float* limit = &lt.in_limit[(size_t)j * lt.stride];
+    alignas(32) float arrivals[MAX_STRIDE];
+    const float32x4_t inf = vdupq_n_f32(INF_TIME);
+    float32x4_t lo = inf;
+    for (int i = 0; i < lt.stride; i += 4) {
+        float32x4_t t = vld1q_f32(prev_row + i);
+        uint32x4_t ok = vcleq_f32(t, vld1q_f32(limit + i));
+        float32x4_t a = vbslq_f32(ok, vaddq_f32(t, vld1q_f32(travel + i)), inf);
+        vst1q_f32(arrivals + i, a);
+        lo = vminq_f32(lo, a);
+    }
+    float min_arrival = vminvq_f32(lo);
+    if (min_arrival >= INF_TIME) return -1;
+    return first_lane_leaving_at(lt, j, arrivals, min_arrival, best);
+}
+#endif
+
+// Widest kernel the CPU supports, chosen once per process.
+static PullKernel select_pull_kernel() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) return pull_avx2;
+    return pull_sse2;
+#elif defined(__aarch64__)
+    return pull_neon;
+#else
+    return pull_scalar;
+#endif
+}
+
+static const PullKernel kPullKernel = select_pull_kernel();
+
+// ── Seconds decoding ────────────────────────────────────────────────
+//
+// Decodes a row of 16-bit times (seconds after base, 0xFFFF unreached)
+// into minutes for the pull kernels. Every variant computes
+// base + q * (1/60) as a separate multiply and add, so all of them give
+// the same floats.
+static const uint16_t UNREACHED_SECONDS = 0xFFFF;
+static const float MINUTES_PER_SECOND = 1.0f / 60.0f;
+
+typedef void (*DecodeKernel)(const uint16_t* src, int n, float base, float* dst);
+
+__attribute__((unused))
+static void decode_scalar(const uint16_t* src, int n, float base, float* dst) {
+    for (int i = 0; i < n; i++) {
+        float minutes = (float)src[i] * MINUTES_PER_SECOND;
+        dst[i] = src[i] == UNREACHED_SECONDS ? INF_TIME : base + minutes;
+    }
+}
+
+#if defined(__x86_64__)
+static void decode_sse2(const uint16_t* src, int n, float base, float* dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i unreached = _mm_set1_epi32(UNREACHED_SECONDS);
+    const __m128 scale = _mm_set1_ps(MINUTES_PER_SECOND);
+    const __m128 offset = _mm_set1_ps(base);
+    const __m128 inf = _mm_set1_ps(INF_TIME);
+    for (int i = 0; i < n; i += 8) {
+        __m128i q16 = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i halves[2] = {_mm_unpacklo_epi16(q16, zero), _mm_unpackhi_epi16(q16, zero)};
+        for (int h = 0; h < 2; h++) {
+            __m128 minutes = _mm_mul_ps(_mm_cvtepi32_ps(halves[h]), scale);
+            __m128 t = _mm_add_ps(offset, minutes);
+            __m128 gone = _mm_castsi128_ps(_mm_cmpeq_epi32(halves[h], unreached));
+            _mm_storeu_ps(dst + i + 4 * h, _mm_or_ps(_mm_and_ps(gone, inf), _mm_andnot_ps(gone, t)));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void decode_avx2(const uint16_t* src, int n, float base, float* dst) {
+    const __m256i unreached = _mm256_set1_epi32(UNREACHED_SECONDS);
+    const __m256 scale = _mm256_set1_ps(MINUTES_PER_SECOND);
+    const __m256 offset = _mm256_set1_ps(base);
+    const __m256 inf = _mm256_set1_ps(INF_TIME);
+    for (int i = 0; i < n; i += 8) {
+        __m256i q = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m256 minutes = _mm256_mul_ps(_mm256_cvtepi32_ps(q), scale);
+        __m256 t = _mm256_add_ps(offset, minutes);
+        __m256 gone = _mm256_castsi256_ps(_mm256_cmpeq_epi32(q, unreached));
+        _mm256_storeu_ps(dst + i, _mm256_blendv_ps(t, inf, gone));
+    }
+}
+#elif defined(__aarch64__)
+static void decode_neon(const uint16_t* src, int n, float base, float* dst) {
+    const uint32x4_t unreached = vdupq_n_u32(UNREACHED_SECONDS);
+    const float32x4_t scale = vdupq_n_f32(MINUTES_PER_SECOND);
+    const float32x4_t offset = vdupq_n_f32(base);
+    const float32x4_t inf = vdupq_n_f32(INF_TIME);
+    for (int i = 0; i < n; i += 4) {
+        uint32x4_t q = vmovl_u16(vld1_u16(src + i));
+        float32x4_t minutes = vmulq_f32(vcvtq_f32_u32(q), scale);
+        float32x4_t t = vaddq_f32(offset, minutes);
+        vst1q_f32(dst + i, vbslq_f32(vceqq_u32(q, unreached), inf, t));
+    }
+}
+#endif
+
+static DecodeKernel select_decode_kernel() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) return decode_avx2;
+    return decode_sse2;
+#elif defined(__aarch64__)
+    return decode_neon;
+#else
+    return decode_scalar;
+#endif
+}
+
+static const DecodeKernel kDecodeKernel = select_decode_kernel();
+
+// ── Superset scans ──────────────────────────────────────────────────
+//
+// Reports whether any of n visited sets m agrees with q on the bits of
+// sel, (m & sel) == q; with q inside sel that means m contains q and
+// adds nothing outside it but bits sel leaves out. Label setting asks
+// this of every stored set that could cover a new label.
+typedef bool (*SupersetKernel)(const uint32_t* masks, size_t n, uint32_t sel, uint32_t q);
+
+static bool superset_scalar(const uint32_t* masks, size_t n, uint32_t sel, uint32_t q) {
+    for (size_t i = 0; i < n; i++) {
+        if ((masks[i] & sel) == q) return true;
+    }
+    return false;
+}
+
+#if defined(__x86_64__)
+static bool superset_sse2(const uint32_t* masks, size_t n, uint32_t sel, uint32_t q) {
+    const __m128i s = _mm_set1_epi32((int)sel);
+    const __m128i want = _mm_set1_epi32((int)q);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*)(masks + i)), s);
+        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*)(masks + i + 4)), s);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi32(a, want), _mm_cmpeq_epi32(b, want));
+        if (_mm_movemask_epi8(hit)) return true;
+    }
+    return superset_scalar(masks + i, n - i, sel, q);
+}
+
+__attribute__((target("avx2")))
+static bool superset_avx2(const uint32_t* masks, size_t n, uint32_t sel, uint32_t q) {
+    const __m256i s = _mm256_set1_epi32((int)sel);
+    const __m256i want = _mm256_set1_epi32((int)q);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(masks + i)), s);
+        __m256i b = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(masks + i + 8)), s);
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi32(a, want), _mm256_cmpeq_epi32(b, want));
+        if (_mm256_movemask_epi8(hit)) return true;
+    }
+    return superset_scalar(masks + i, n - i, sel, q);
+}
+#elif defined(__aarch64__)
+static bool superset_neon(const uint32_t* masks, size_t n, uint32_t sel, uint32_t q) {
+    const uint32x4_t s = vdupq_n_u32(sel);
+    const uint32x4_t want = vdupq_n_u32(q);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint32x4_t a = vceqq_u32(vandq_u32(vld1q_u32(masks + i), s), want);
+        uint32x4_t b = vceqq_u32(vandq_u32(vld1q_u32(masks + i + 4), s), want);
+        if (vmaxvq_u32(vorrq_u32(a, b))) return true;
+    }
+    return superset_scalar(masks + i, n - i, sel, q);
+}
+#endif
+
+static SupersetKernel select_superset_kernel() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) return superset_avx2;
+    return superset_sse2;
+#elif defined(__aarch64__)
+    return superset_neon;
+#else
+    return superset_scalar;
+#endif
+}
+
+static const SupersetKernel kSupersetKernel = select_superset_kernel();
+
+// Finish check-in time for an arrival that is known to be accepted.
+static inline float finish_time_at(const OpenTable& table, float finish_arrival) {
+    int w = finish_arrival > (float)table.base ? (int)finish_arrival - table.base : 0;
+    float open = table.finish_next[w];
+    return finish_arrival > open ? finish_arrival : open;
+}
+
+// Persistent worker threads for one solve. run() calls fn(worker) on every
+// worker, with the calling thread acting as worker 0, and returns once all
+// of them have finished.
+class WorkerPool {
+public:
+    explicit WorkerPool(int n_workers) : n_workers_(n_workers) {
+        for (int w = 1; w < n_workers_; w++) {
+            threads_.emplace_back([this, w] { worker_loop(w); });
         }
-        // Deduplicate next popcount bucket
-        if (pc + 1 <= N) {
-            std::sort(masks_by_pc[pc + 1].begin(), masks_by_pc[pc + 1].end());
-            masks_by_pc[pc + 1].erase(
-                std::unique(masks_by_pc[pc + 1].begin(), masks_by_pc[pc + 1].end()),
-                masks_by_pc[pc + 1].end());
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
         }
+        start_cv_.notify_all();
+        for (std::thread& t : threads_) t.join();
     }
 
-    // Find the best result
-    int best_count = -1;
-    float best_finish_time = INF_TIME;
-    int best_mask = -1;
-    int best_last = -1;
+    int size() const { return n_workers_; }
 
-    for (int mask = 1; mask < (1 << N); mask++) {
-        int count = popcount(mask);
-        for (int i = 0; i < N; i++) {
-            int si = idx(mask, i);
-            if (dp[si] >= INF_TIME) continue;
-            // Can we reach Finish?
-            float finish_arr = dp[si] + input->travel_time[i][FINISH_IDX];
-            if (finish_arr > (float)input->end_time) continue;
-
-            int fslot = arrival_to_slot_index(finish_arr, input);
-            if (fslot < 0) continue;
-
-            float actual_finish = -1.0f;
-            for (int s = fslot; s < input->n_slots; s++) {
-                if (input->finish_open[s]) {
-                    actual_finish = finish_arr > (float)input->slot_starts[s]
-                                    ? finish_arr : (float)input->slot_starts[s];
-                    break;
-                }
+    void run(const std::function<void(int)>& fn) {
+        if (n_workers_ == 1) {
+            fn(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &fn;
+            pending_ = n_workers_ - 1;
+            generation_++;
+        }
+        start_cv_.notify_all();
+        fn(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    void worker_loop(int w) {
+        uint64_t seen = 0;
+        while (true) {
+            const std::function<void(int)>* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) return;
+                seen = generation_;
+                job = job_;
             }
-            if (actual_finish < 0.0f || actual_finish > (float)input->end_time) continue;
+            (*job)(w);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            done_cv_.notify_one();
+        }
+    }
 
-            if ((count > best_count) ||
-                (count == best_count && actual_finish < best_finish_time)) {
-                best_count = count;
-                best_finish_time = actual_finish;
-                best_mask = mask;
-                best_last = i;
+    int n_workers_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(int)>* job_ = nullptr;
+    int pending_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+};
+
+// The pool in *pool, replaced first if it does not have n_workers workers.
+static WorkerPool& pool_of_size(std::unique_ptr<WorkerPool>* pool, int n_workers) {
+    if (!*pool || (*pool)->size() != n_workers) {
+        pool->reset();
+        pool->reset(new WorkerPool(n_workers));
+    }
+    return **pool;
+}
+
+// Work-stealing distribution of chunk indices. Each worker starts with a
+// contiguous range and pops from its front; a worker that runs dry steals
+// the back half of another worker's range. A range is packed as
+// (begin << 32) | end so both ends move with a single CAS.
+class ChunkQueues {
+public:
+    explicit ChunkQueues(int n_workers) : ranges_(n_workers) {}
+
+    void reset(uint32_t n_chunks) {
+        uint32_t n = (uint32_t)ranges_.size();
+        for (uint32_t w = 0; w < n; w++) {
+            uint32_t begin = (uint32_t)((uint64_t)n_chunks * w / n);
+            uint32_t end = (uint32_t)((uint64_t)n_chunks * (w + 1) / n);
+            ranges_[w].packed.store(pack(begin, end), std::memory_order_relaxed);
+        }
+    }
+
+    bool next(int worker, uint32_t* chunk) {
+        if (pop(worker, chunk)) return true;
+        int n = (int)ranges_.size();
+        for (int k = 1; k < n; k++) {
+            if (steal((worker + k) % n, worker)) {
+                if (pop(worker, chunk)) return true;
             }
         }
+        return false;
     }
 
-    if (best_count < 0) {
-        result->count = 0;
-        result->route_length = 0;
-        result->finish_time = 0.0f;
-        LOGI("No feasible route found");
-        return;
+private:
+    struct alignas(64) Range {
+        std::atomic<uint64_t> packed{0};
+    };
+
+    static uint64_t pack(uint32_t begin, uint32_t end) { return ((uint64_t)begin << 32) | end; }
+
+    bool pop(int worker, uint32_t* chunk) {
+        std::atomic<uint64_t>& r = ranges_[worker].packed;
+        uint64_t cur = r.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t begin = (uint32_t)(cur >> 32), end = (uint32_t)cur;
+            if (begin >= end) return false;
+            if (r.compare_exchange_weak(cur, pack(begin + 1, end), std::memory_order_acq_rel)) {
+                *chunk = begin;
+                return true;
+            }
+        }
+    }
+
+    // Moves the back half of victim's range to thief, whose range is empty.
+    bool steal(int victim, int thief) {
+        std::atomic<uint64_t>& r = ranges_[victim].packed;
+        uint64_t cur = r.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t begin = (uint32_t)(cur >> 32), end = (uint32_t)cur;
+            if (begin >= end) return false;
+            uint32_t mid = end - (end - begin + 1) / 2;
+            if (r.compare_exchange_weak(cur, pack(begin, mid), std::memory_order_acq_rel)) {
+                ranges_[thief].packed.store(pack(mid, end), std::memory_order_release);
+                return true;
+            }
+        }
     }
 
-    // Reconstruct route
-    int route_buf[MAX_CP];
-    int route_len = 0;
-    int cur_mask = best_mask;
-    int cur_pos = best_last;
+    std::vector<Range> ranges_;
+};
 
-    while (true) {
-        route_buf[route_len++] = cur_pos;
-        int si = idx(cur_mask, cur_pos);
-        int p = parent[si];
-        if (p == -1) {
-            // Came from Start
-            break;
+// Binomial coefficients C(n, k) for n, k <= MAX_CP.
+struct Binomials {
+    uint64_t c[MAX_CP + 1][MAX_CP + 1];
+
+    Binomials() {
+        memset(c, 0, sizeof(c));
+        for (int n = 0; n <= MAX_CP; n++) {
+            c[n][0] = 1;
+            for (int k = 1; k <= n; k++) c[n][k] = c[n - 1][k - 1] + c[n - 1][k];
         }
-        if (p == -2) {
-            // Should not happen
-            LOGE("Parent chain broken at mask=%d pos=%d", cur_mask, cur_pos);
-            break;
+    }
+
+    // Position of mask among the masks of its popcount in increasing-mask
+    // (colex) order: the sum of C(b, t) over its t-th lowest set bit b.
+    uint64_t rank(int mask) const {
+        uint64_t r = 0;
+        for (int t = 1; mask; t++, mask &= mask - 1) r += c[__builtin_ctz(mask)][t];
+        return r;
+    }
+
+    // The mask of popcount k at position `rank` in increasing-mask (colex)
+    // order, i.e. the rank-th mask Gosper's hack would produce.
+    int unrank(uint64_t rank, int k) const {
+        int mask = 0;
+        for (int t = k; t > 0; t--) {
+            int bit = t - 1;
+            while (c[bit + 1][t] <= rank) bit++;
+            mask |= 1 << bit;
+            rank -= c[bit][t];
         }
-        int prev_pos = p & 0x1F;
-        int prev_mask = p >> 5;
-        cur_mask = prev_mask;
-        cur_pos = prev_pos;
+        return mask;
+    }
+};
+
+static const Binomials kBinomials;
+
+// ── Counters ────────────────────────────────────────────────────────
+//
+// With SOLVER_COUNTERS defined, COUNT(...) keeps its statements and each
+// pass fills a SolveCounters; otherwise they compile away.
+#ifdef SOLVER_COUNTERS
+#define COUNT(...) __VA_ARGS__
+
+// Adds the time since the previous lap (or construction) to a phase total.
+class PhaseClock {
+public:
+    void lap(double* ms) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        *ms += std::chrono::duration<double, std::milli>(now - last_).count();
+        last_ = now;
     }
 
-    // Reverse the route
-    result->count = best_count;
-    result->route_length = route_len;
-    result->finish_time = best_finish_time;
-    for (int i = 0; i < route_len; i++) {
-        result->route[i] = route_buf[route_len - 1 - i];
+private:
+    std::chrono::steady_clock::time_point last_ = std::chrono::steady_clock::now();
+};
+
+// Counts the legs into j from the reached states of prev_row, and for each
+// one the pull kernel rejects, which part of its Leg::depart_limit fails.
+// Reached departures never pass end_time; unreached entries read as
+// INF_TIME in either time mode.
+static void count_legs(const LegTable& lt, const float* prev_row, int j, float end_time,
+                       SolveCounters* c) {
+    const float* travel = &lt.in_travel[(size_t)j * lt.stride];
+    const float* limit = &lt.in_limit[(size_t)j * lt.stride];
+    for (int i = 0; i < lt.n_checkpoints; i++) {
+        if (prev_row[i] > end_time) continue;
+        c->transitions++;
+        if (prev_row[i] <= limit[i]) continue;
+        float arrival = prev_row[i] + travel[i];
+        if (arrival > end_time) c->past_end_time++;
+        else if (lt.ready[(size_t)j * lt.span + ((int)arrival - lt.base)] >= INF_TIME) c->window_closed++;
+        else c->finish_unreachable++;
     }
+}
 
-    LOGI("Solved: %d checkpoints, finish=%.1f", best_count, best_finish_time);
+static void log_counters(const SolveCounters& c, int N) {
+    char layers[(MAX_CP + 1) * 32];
+    int len = 0;
+    for (int pc = 1; pc <= N; pc++) {
+        len += snprintf(layers + len, sizeof layers - len, " %lld/%lld",
+                        (long long)c.reached[pc], (long long)c.live[pc]);
+    }
+    LOGI("Reached states/live masks by layer:%s", layers);
+    LOGI("Transitions: %lld tried, rejected %lld past end time, %lld closed window, "
+         "%lld cannot reach Finish", (long long)c.transitions, (long long)c.past_end_time,
+         (long long)c.window_closed, (long long)c.finish_unreachable);
+    LOGI("Phases: init %.2f ms, layers %.2f ms, best scan %.2f ms, reconstruction %.2f ms",
+         c.init_ms, c.layers_ms, c.best_scan_ms, c.reconstruct_ms);
 }
+#else
+#define COUNT(...)
+#endif
 
+static void add_counters(const SolveCounters& from, SolveCounters* into) {
+    for (int pc = 0; pc <= MAX_CP; pc++) {
+        into->reached[pc] += from.reached[pc];
+        into->live[pc] += from.live[pc];
+    }
+    into->transitions += from.transitions;
+    into->past_end_time += from.past_end_time;
+    into->window_closed += from.window_closed;
+    into->finish_unreachable += from.finish_unreachable;
+    into->init_ms += from.init_ms;
+    into->layers_ms += from.layers_ms;
+    into->best_scan_ms += from.best_scan_ms;
+    into->reconstruct_ms += from.reconstruct_ms;
+}
 
-// ── JNI Bridge ──────────────────────────────────────────────────────
+static int resolve_thread_count(int requested) {
+    if (requested > 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? (int)hw : 1;
+}
 
-extern "C" JNIEXPORT jintArray JNICALL
-Java_com_scout_routeplanner_solver_NativeSolver_solveNative(
-    JNIEnv* env, jobject /* thiz */,
-    jfloatArray travelTimeMatrix,
-    jbooleanArray openingsFlat,
-    jbooleanArray finishOpenings,
-    jintArray slotStarts,
-    jfloat speed, jint dwell, jfloat naismith,
-    jint startTime, jint endTime,
-    jint nCheckpoints, jint nSlots)
-{
-    SolverInput input;
-    memset(&input, 0, sizeof(input));
-    input.n_checkpoints = nCheckpoints;
-    input.n_slots = nSlots;
-    input.speed = speed;
-    input.dwell = dwell;
-    input.naismith = naismith;
-    input.start_time = startTime;
-    input.end_time = endTime;
+// Largest data cache the system reports, or DEFAULT_CACHE_BYTES if it
+// reports none.
+static size_t last_level_cache_bytes() {
+    long largest = 0;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+    largest = std::max({sysconf(_SC_LEVEL1_DCACHE_SIZE), sysconf(_SC_LEVEL2_CACHE_SIZE),
+                        sysconf(_SC_LEVEL3_CACHE_SIZE)});
+#endif
+    return largest > 0 ? (size_t)largest : DEFAULT_CACHE_BYTES;
+}
+
+static const size_t kCacheBytes = last_level_cache_bytes();
+
+// Slots of the masks a sparse DP table stores, by open addressing on the
+// mask. Stored masks are never 0, so 0 marks an empty entry, and a mask
+// that is not stored finds slot 0.
+class MaskIndex {
+public:
+    MaskIndex() { clear(); }
+
+    void clear() {
+        entries_.assign(16, Entry{0, 0});
+        bits_ = 4;
+        size_ = 0;
+    }
+
+    void insert(uint32_t mask, uint32_t slot) {
+        if (2 * (size_ + 1) > entries_.size()) grow();
+        place(Entry{mask, slot});
+        size_++;
+    }
+
+    uint32_t find(uint32_t mask) const {
+        size_t wrap = entries_.size() - 1;
+        for (size_t e = hash(mask); ; e = (e + 1) & wrap) {
+            if (entries_[e].mask == mask) return entries_[e].slot;
+            if (entries_[e].mask == 0) return 0;
+        }
+    }
+
+    size_t bytes() const { return entries_.capacity() * sizeof(Entry); }
+
+private:
+    struct Entry {
+        uint32_t mask;
+        uint32_t slot;
+    };
+
+    size_t hash(uint32_t mask) const { return (mask * 0x9E3779B1u) >> (32 - bits_); }
+
+    void place(Entry entry) {
+        size_t wrap = entries_.size() - 1;
+        size_t e = hash(entry.mask);
+        while (entries_[e].mask != 0) e = (e + 1) & wrap;
+        entries_[e] = entry;
+    }
+
+    void grow() {
+        std::vector<Entry> old(entries_.size() * 2, Entry{0, 0});
+        old.swap(entries_);
+        bits_++;
+        for (const Entry& entry : old) {
+            if (entry.mask != 0) place(entry);
+        }
+    }
+
+    std::vector<Entry> entries_;
+    int bits_;
+    size_t size_;
+};
+
+// Filled DP table for up to MAX_LANES lanes. Each visited set has a slot,
+// and the row of (slot, lane) is at (slot * n_lanes + lane) * N. Beyond
+// the solve itself it answers "best route avoiding these checkpoints"
+// queries, so exclusion analysis keeps one alive. There is no parent
+// table: routes are recovered from dp and the leg tables (see
+// best_routes).
+//
+// A sparse table only stores the masks its DP pass reached, slot by slot
+// in popcount then mask order behind slot 0, an unreached row that every
+// other mask reads, and finds them through index (see run_dp). A dense
+// one stores every mask. Its slot is usually the mask itself, which
+// spreads each layer over the whole table; once the table outgrows the
+// last-level cache it is ranked instead, in the sparse order, so a
+// mask's slot is the start of its layer plus its colex rank and the DP
+// streams through the layer it reads and the one it writes.
+//
+// In seconds mode dp_s replaces dp. A stored time is the departure rounded
+// down to a whole second after open_table.base, so the table reaches every
+// state the float one does, though a route it finds may miss a window in
+// floats; solve_lanes replays each route in floats to check. 0xFFFF is
+// unreached. Rows are decoded into a caller's buffer before the float
+// kernels run.
+struct DpTable {
+    int n_checkpoints;
+    int n_lanes;
+    bool seconds;
+    bool complete;      // every state relaxed; false after a stopped pass
+    bool sparse;
+    bool ranked;        // dense rows in layer order rather than mask order
+    OpenTable open_table;
+    std::vector<std::vector<float>> depart_limit;   // per lane
+    std::vector<std::vector<float>> finish_travel;  // per lane, tt(i, Finish)
+    std::vector<LegTable> legs;                     // per lane
+    std::vector<float> dp;
+    std::vector<uint16_t> dp_s;
+    std::vector<uint8_t> live;                      // lanes reaching each slot
+    std::vector<size_t> layer_start;                // ranked: first slot of each popcount
+    std::vector<uint32_t> slot_mask;                // sparse: mask of each slot
+    MaskIndex index;                                // sparse: slot of each mask
+
+    size_t n_slots() const { return sparse ? slot_mask.size() : (size_t)1 << n_checkpoints; }
+
+    size_t slot(int mask) const {
+        if (sparse) return index.find((uint32_t)mask);
+        if (ranked) return layer_start[popcount(mask)] + kBinomials.rank(mask);
+        return (size_t)mask;
+    }
+
+    size_t row_at(size_t slot, int lane) const {
+        return (slot * n_lanes + lane) * n_checkpoints;
+    }
 
-    // Copy travel time matrix (ALL_NODES x ALL_NODES flattened)
-    jfloat* ttFlat = env->GetFloatArrayElements(travelTimeMatrix, nullptr);
-    for (int i = 0; i < ALL_NODES; i++) {
-        for (int j = 0; j < ALL_NODES; j++) {
-            input.travel_time[i][j] = ttFlat[i * ALL_NODES + j];
+    void store(size_t at, float depart) {
+        if (!seconds) {
+            dp[at] = depart;
+            return;
         }
+        // Rounded down, to a time that decodes no later than depart, so the
+        // table reaches every state the float one does
+        float q = std::floor((depart - (float)open_table.base) * 60.0f);
+        q = std::max(0.0f, std::min(q, (float)(UNREACHED_SECONDS - 1)));
+        if (q > 0.0f && (float)open_table.base + q * MINUTES_PER_SECOND > depart) q -= 1.0f;
+        dp_s[at] = (uint16_t)q;
+    }
+
+    // One stored time as the kernels see it.
+    float load(size_t at) const {
+        if (!seconds) return dp[at];
+        float minutes = (float)dp_s[at] * MINUTES_PER_SECOND;
+        return dp_s[at] == UNREACHED_SECONDS ? INF_TIME : (float)open_table.base + minutes;
+    }
+
+    // The (slot, lane) row as floats, padded to the kernel stride: the dp
+    // row itself, or the seconds row decoded into buf (MAX_STRIDE floats).
+    const float* slot_floats(size_t slot, int lane, float* buf) const {
+        size_t r = row_at(slot, lane);
+        if (!seconds) return &dp[r];
+        kDecodeKernel(&dp_s[r], legs[lane].stride, (float)open_table.base, buf);
+        return buf;
+    }
+
+    const float* row_floats(int mask, int lane, float* buf) const {
+        return slot_floats(slot(mask), lane, buf);
+    }
+
+    // Grows the table to n slots, the new rows unreached. Rows keep a
+    // padded row of slack behind them so kernels can read a full stride
+    // past the last state.
+    void resize_slots(size_t n) {
+        size_t states = n * n_lanes * n_checkpoints + MAX_STRIDE;
+        if (seconds) dp_s.resize(states, UNREACHED_SECONDS);
+        else dp.resize(states, INF_TIME);
+        live.resize(n, 0);
+    }
+
+    // Spreads a sparse table's rows to their masks' dense slots,
+    // keeping the capacity of any earlier dense solve.
+    void make_dense(bool layered) {
+        size_t width = (size_t)n_lanes * n_checkpoints;
+        size_t n_masks = (size_t)1 << n_checkpoints;
+        sparse = false;
+        ranked = layered;
+        std::vector<size_t> dense_slots(slot_mask.size());
+        for (size_t s = 1; s < slot_mask.size(); s++) dense_slots[s] = slot((int)slot_mask[s]);
+        auto spread = [&](auto& rows, auto unreached) {
+            std::remove_reference_t<decltype(rows)> stored(rows.begin(), rows.end());
+            rows.assign(n_masks * width + MAX_STRIDE, unreached);
+            for (size_t s = 1; s < slot_mask.size(); s++) {
+                std::copy_n(&stored[s * width], width, &rows[dense_slots[s] * width]);
+            }
+        };
+        if (seconds) spread(dp_s, UNREACHED_SECONDS);
+        else spread(dp, INF_TIME);
+        std::vector<uint8_t> stored_live(live.begin(), live.end());
+        live.assign(n_masks, 0);
+        for (size_t s = 1; s < slot_mask.size(); s++) live[dense_slots[s]] = stored_live[s];
+        std::vector<uint32_t>().swap(slot_mask);
+        index.clear();
+    }
+
+    size_t bytes() const {
+        return dp.capacity() * sizeof(float) + dp_s.capacity() * sizeof(uint16_t) + live.capacity() +
+            slot_mask.capacity() * sizeof(uint32_t) + index.bytes();
     }
-    env->ReleaseFloatArrayElements(travelTimeMatrix, ttFlat, 0);
+};
+
+// Memory and threads kept between solves. The DP table's vectors keep
+// their capacity, so a repeat solve of the same size (every probe of a
+// speed search, say) refills the table in place instead of allocating
+// and page-faulting it again, and the pool's threads stay parked. Used by
+// one solve at a time; NativeSolver serialises calls on its workspace.
+struct Workspace {
+    DpTable table;
+    std::unique_ptr<WorkerPool> pool;
+    SolveStats stats{};
+
+    // Early stopping and progress (see cancel_solve). Only cancelled is
+    // touched from other threads.
+    std::atomic<bool> cancelled{false};
+    double budget_ms = 0.0;
+    ProgressFn progress;
+    std::chrono::steady_clock::time_point deadline;
+    bool stopped = false;
+
+    // Starts the budget of an API call.
+    void begin_call() {
+        stopped = false;
+        deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(budget_ms));
+    }
+
+    bool should_stop() const {
+        return cancelled.load(std::memory_order_relaxed) ||
+            (budget_ms > 0.0 && std::chrono::steady_clock::now() >= deadline);
+    }
+
+    // Counts a pass that has just filled `states` states in `bytes`.
+    void record_pass(int64_t states, size_t bytes, const SolveCounters& counters) {
+        add_counters(counters, &stats.counters);
+        stats.dp_passes++;
+        stats.states += states;
+        stats.peak_table_bytes = std::max(stats.peak_table_bytes, bytes);
+    }
+
+    void record_pass(const DpTable& filled, const SolveCounters& counters) {
+        record_pass((int64_t)filled.n_slots() * filled.n_checkpoints * filled.n_lanes,
+                    filled.bytes(), counters);
+    }
+
+    // Frees a table too large to keep resident between solves.
+    void trim() {
+        if (table.bytes() <= WORKSPACE_RETAIN_BYTES) return;
+        LOGI("Releasing %zu MB DP table", table.bytes() >> 20);
+        table = DpTable();
+    }
+};
 
-    // Copy openings (N x nSlots flattened)
-    jboolean* openFlat = env->GetBooleanArrayElements(openingsFlat, nullptr);
-    for (int i = 0; i < nCheckpoints; i++) {
-        for (int s = 0; s < nSlots; s++) {
-            input.open_at[i][s] = openFlat[i * nSlots + s] != 0;
+// Fills everything in table but the dp times for up to MAX_LANES inputs,
+// which must agree on everything but travel_time and speed. The builders
+// overwrite every entry, so the per-lane tables are resized in place.
+static void build_lane_tables(const SolverInput* inputs, int n_lanes, DpTable* table) {
+    int N = inputs[0].n_checkpoints;
+    table->n_checkpoints = N;
+    table->n_lanes = n_lanes;
+    build_open_table(&inputs[0], &table->open_table);
+    table->depart_limit.resize(n_lanes);
+    table->finish_travel.resize(n_lanes);
+    table->legs.resize(n_lanes);
+    for (int lane = 0; lane < n_lanes; lane++) {
+        build_depart_limits(&inputs[lane], table->open_table, &table->depart_limit[lane]);
+        build_leg_table(&inputs[lane], table->open_table, table->depart_limit[lane],
+                        &table->legs[lane]);
+        table->finish_travel[lane].resize(N);
+        for (int i = 0; i < N; i++) {
+            table->finish_travel[lane][i] = inputs[lane].tt(i, inputs[lane].finish_idx());
         }
     }
-    env->ReleaseBooleanArrayElements(openingsFlat, openFlat, 0);
+}
+
+// Main bitmask DP, run for up to MAX_LANES inputs at once. The inputs
+// ("lanes", one per walking speed) must agree on everything but
+// travel_time and speed. They share one pass over the mask lattice, the
+// opening tables and the worker pool, and their dp rows for a mask sit
+// next to each other, so every predecessor mask is fetched once per pass
+// rather than once per speed. Each lane is relaxed exactly as a solo solve
+// would relax it. counters is only written with SOLVER_COUNTERS defined.
+//
+// Tight days reach a small share of the lattice, so the pass starts
+// sparse: each layer stores only the masks one feasible leg from a state
+// of the layer before, found while that layer was relaxed. Once a layer
+// would take the stored masks past 2^N / SPARSE_MASK_DIVISOR the rows are
+// spread into a dense table, ranked by layer if it is bigger than the
+// cache, and the rest of the pass walks every mask.
+//
+// The workspace supplies the worker pool and the stop conditions. Returns
+// false if the pass stopped early: every mask of the earlier layers and
+// some of the last one are relaxed, the rest are left unreached, so the
+// table holds a consistent subset of the states.
+static bool run_dp(const SolverInput* inputs, int n_lanes, DpTable* table, Workspace* ws,
+                   [[maybe_unused]] SolveCounters* counters) {
+    COUNT(PhaseClock clock;)
+    const SolverInput* input = &inputs[0];
+    int N = input->n_checkpoints;
+    size_t total_states = ((size_t)1 << N) * (size_t)N * (size_t)n_lanes;
+
+    // Small tables are not worth waking extra threads for
+    int n_workers = std::min(resolve_thread_count(input->n_threads), (1 << N) / 1024 + 1);
+
+    LOGI("Solving: N=%d, speeds=%d (%.2f..%.2f), states=%zu, threads=%d",
+         N, n_lanes, inputs[0].speed, inputs[n_lanes - 1].speed, total_states, n_workers);
+
+    build_lane_tables(inputs, n_lanes, table);
+
+    // Seconds mode needs every departure, at most end_time, to fit below
+    // the unreached marker
+    table->seconds = input->time_mode == TIME_SECONDS &&
+        (input->end_time - table->open_table.base) * 60 < UNREACHED_SECONDS;
+    if (input->time_mode == TIME_SECONDS && !table->seconds) {
+        LOGI("Day too long for 16-bit times, storing floats");
+    }
 
-    // Copy finish openings
-    jboolean* finOpen = env->GetBooleanArrayElements(finishOpenings, nullptr);
-    for (int s = 0; s < nSlots; s++) {
-        input.finish_open[s] = finOpen[s] != 0;
+    // Start with only the unreached slot 0, reusing the table's capacity
+    // from any earlier solve
+    if (table->seconds) {
+        std::vector<float>().swap(table->dp);
+        table->dp_s.clear();
+    } else {
+        std::vector<uint16_t>().swap(table->dp_s);
+        table->dp.clear();
+    }
+    table->live.clear();
+    table->layer_start.assign(N + 2, 0);
+    for (int k = 0; k <= N; k++) {
+        table->layer_start[k + 1] = table->layer_start[k] + kBinomials.c[N][k];
     }
-    env->ReleaseBooleanArrayElements(finishOpenings, finOpen, 0);
+    table->sparse = true;
+    table->ranked = false;
+    table->slot_mask.assign(1, 0);
+    table->index.clear();
+    table->resize_slots(1);
 
-    // Copy slot starts
-    jint* slotStartsArr = env->GetIntArrayElements(slotStarts, nullptr);
-    for (int s = 0; s < nSlots; s++) {
-        input.slot_starts[s] = slotStartsArr[s];
+    const std::vector<LegTable>& legs = table->legs;
+    float depart_start = (float)input->start_time;
+
+    // Frontier: for every visited set, the lanes that reach any (mask, pos)
+    // state. A mask's entry is only written while relaxing that mask and
+    // only read by the next layer, after the pool has joined.
+    std::vector<uint8_t>& live = table->live;
+
+    // While sparse, the checkpoints each slot of the current layer can
+    // walk on to; the next layer stores exactly these extensions
+    std::vector<uint32_t> next_steps;
+    size_t layer_first = 1;
+
+    // The legs out of each (lane, i) by falling depart_limit, and the
+    // targets of the first k + 1 of them, so the checkpoints a departure
+    // can reach are one binary search away
+    size_t n_out = (size_t)n_lanes * N * N;
+    std::vector<float> out_limit(n_out);
+    std::vector<uint32_t> out_targets(n_out);
+    for (int lane = 0; lane < n_lanes; lane++) {
+        for (int i = 0; i < N; i++) {
+            size_t first = ((size_t)lane * N + i) * N;
+            int order[MAX_CP];
+            for (int j = 0; j < N; j++) order[j] = j;
+            std::sort(order, order + N, [&](int a, int b) {
+                return legs[lane].leg(i, a).depart_limit > legs[lane].leg(i, b).depart_limit;
+            });
+            uint32_t targets = 0;
+            for (int k = 0; k < N; k++) {
+                targets |= 1u << order[k];
+                out_limit[first + k] = legs[lane].leg(i, order[k]).depart_limit;
+                out_targets[first + k] = targets;
+            }
+        }
     }
-    env->ReleaseIntArrayElements(slotStarts, slotStartsArr, 0);
+    auto successors = [&](int mask, size_t slot) {
+        alignas(32) float buf[MAX_STRIDE];
+        uint32_t steps = 0;
+        for (int lanes = live[slot]; lanes; lanes &= lanes - 1) {
+            int lane = __builtin_ctz(lanes);
+            const float* dp_row = table->slot_floats(slot, lane, buf);
+            for (int i = 0; i < N; i++) {
+                if (dp_row[i] >= INF_TIME) continue;
+                const float* limit = &out_limit[((size_t)lane * N + i) * N];
+                int n_legs = (int)(std::upper_bound(limit, limit + N, dp_row[i],
+                                                    std::greater<float>()) - limit);
+                if (n_legs > 0) steps |= out_targets[((size_t)lane * N + i) * N + n_legs - 1];
+            }
+        }
+        return steps & ~(uint32_t)mask;
+    };
 
-    // Solve
-    SolverResult result;
-    memset(&result, 0, sizeof(result));
-    solve(&input, &result);
+    // Initialize: Start -> each intermediate CP
+    int best_count = 0;
+    for (int j = 0; j < N; j++) {
+        size_t slot = 0;
+        for (int lane = 0; lane < n_lanes; lane++) {
+            float depart_j = take_leg(legs[lane], N, j, depart_start);
+            if (depart_j >= INF_TIME) continue;
 
-    // Return as int array: [count, route_length, finish_time_x100, route[0], route[1], ...]
-    int outputSize = 3 + result.route_length;
-    jintArray output = env->NewIntArray(outputSize);
-    std::vector<jint> outBuf(outputSize);
-    outBuf[0] = result.count;
-    outBuf[1] = result.route_length;
-    outBuf[2] = (int)(result.finish_time * 100.0f); // encode as centiseconds
-    for (int i = 0; i < result.route_length; i++) {
-        outBuf[3 + i] = result.route[i];
+            int mask = 1 << j;
+            if (slot == 0) {
+                slot = table->slot_mask.size();
+                table->slot_mask.push_back(mask);
+                table->index.insert(mask, (uint32_t)slot);
+                table->resize_slots(slot + 1);
+            }
+            table->store(table->row_at(slot, lane) + j, depart_j);
+            live[slot] |= (uint8_t)(1 << lane);
+            if (table->load(table->row_at(slot, lane) + j) <= table->depart_limit[lane][j]) {
+                best_count = 1;
+            }
+            COUNT(counters->reached[1]++; counters->live[1]++;)
+        }
     }
-    env->SetIntArrayRegion(output, 0, outputSize, outBuf.data());
+    for (size_t slot = layer_first; slot < table->slot_mask.size(); slot++) {
+        next_steps.push_back(successors(table->slot_mask[slot], slot));
+    }
+    COUNT(clock.lap(&counters->init_ms);)
+    if (ws->progress) ws->progress(SolveProgress{1, N, best_count});
+
+    // Whether any state of the current layer can still reach Finish
+    std::atomic<bool> layer_finishes{false};
+
+    // Pull step for one mask: each (mask, j) takes the earliest departure
+    // over predecessors (mask ^ j, i). The kernels keep the lowest i on
+    // ties, matching the push-style loop this replaced. Only this mask's
+    // entries are written, so masks of one layer can be relaxed in any
+    // order and on any thread.
+    auto relax_mask = [&](int mask, size_t slot, bool last_layer,
+                          [[maybe_unused]] SolveCounters* c) {
+        alignas(32) float buf[MAX_STRIDE];
+        uint8_t reached = 0;
+        bool finishes = false;
+        int pc = popcount(mask);
+        auto pull = [&](size_t prev, int j) {
+            for (int lanes = live[prev]; lanes; lanes &= lanes - 1) {
+                int lane = __builtin_ctz(lanes);
+                float best;
+                const float* prev_row = table->slot_floats(prev, lane, buf);
+                COUNT(count_legs(legs[lane], prev_row, j, table->open_table.end_time, c);)
+                if (kPullKernel(legs[lane], prev_row, j, &best) < 0) continue;
+                size_t index = table->row_at(slot, lane) + j;
+                table->store(index, best);
+                reached |= (uint8_t)(1 << lane);
+                finishes |= table->load(index) <= table->depart_limit[lane][j];
+                COUNT(c->reached[pc]++;)
+            }
+        };
+        bool sparse = table->sparse;
+        if (sparse) {
+            for (int rest = mask; rest; rest &= rest - 1) {
+                int j = __builtin_ctz(rest);
+                pull(table->index.find((uint32_t)(mask ^ (1 << j))), j);
+            }
+        } else if (table->ranked) {
+            // Clearing the t-th lowest bit j drops its term C(j, t) from
+            // the mask's rank and moves each bit b above it down a term,
+            // from C(b, u) to C(b, u - 1). Walking down the bits gets every
+            // predecessor's slot from the mask's own rank.
+            size_t base = slot - table->layer_start[pc] + table->layer_start[pc - 1];
+            uint64_t lowered = 0;
+            int t = pc;
+            for (int rest = mask; rest; t--) {
+                int j = 31 - __builtin_clz(rest);
+                rest ^= 1 << j;
+                const uint64_t* terms = kBinomials.c[j];
+                pull(base - terms[t] - lowered, j);
+                lowered += terms[t] - terms[t - 1];
+            }
+        } else {
+            for (int rest = mask; rest; rest &= rest - 1) {
+                int j = __builtin_ctz(rest);
+                pull((size_t)(mask ^ (1 << j)), j);
+            }
+        }
+        live[slot] = reached;
+        if (sparse && !last_layer) next_steps[slot - layer_first] = successors(mask, slot);
+        if (finishes && !layer_finishes.load(std::memory_order_relaxed)) {
+            layer_finishes.store(true, std::memory_order_relaxed);
+        }
+        COUNT(c->live[pc] += popcount(reached);)
+    };
+
+    // Main DP loop: layers in popcount order, each split into chunks of
+    // consecutive masks that the workers share out by work stealing. Each
+    // worker checks the stop conditions before taking a chunk.
+    WorkerPool& workers = pool_of_size(&ws->pool, n_workers);
+    std::atomic<bool> stop{false};
+    ChunkQueues queues(n_workers);
+    const uint64_t chunk_size = 256;
+    struct alignas(64) WorkerCounters {
+        SolveCounters c;
+    };
+    std::vector<WorkerCounters> worker_counters(n_workers, WorkerCounters{});
+    std::vector<uint32_t> extensions;
+    std::vector<uint64_t> extension_bits(((size_t)1 << N) / 64 + 1, 0);
+    for (int pc = 2; pc <= N; pc++) {
+        uint64_t layer_size = kBinomials.c[N][pc];
+        if (table->sparse) {
+            // Each extension is reached from up to pc stored masks; a bit
+            // per mask merges them and reads them back in increasing order
+            for (size_t slot = layer_first; slot < table->slot_mask.size(); slot++) {
+                uint32_t mask = table->slot_mask[slot];
+                for (uint32_t steps = next_steps[slot - layer_first]; steps; steps &= steps - 1) {
+                    uint32_t next = mask | 1u << __builtin_ctz(steps);
+                    extension_bits[next >> 6] |= (uint64_t)1 << (next & 63);
+                }
+            }
+            extensions.clear();
+            for (size_t w = 0; w < extension_bits.size(); w++) {
+                for (uint64_t bits = extension_bits[w]; bits; bits &= bits - 1) {
+                    extensions.push_back((uint32_t)(w << 6) | __builtin_ctzll(bits));
+                }
+                extension_bits[w] = 0;
+            }
+
+            size_t stored = table->slot_mask.size() + extensions.size();
+            if (stored > ((size_t)1 << N) / SPARSE_MASK_DIVISOR) {
+                size_t dense_bytes = total_states * (table->seconds ? sizeof(uint16_t) : sizeof(float));
+                bool layered = dense_bytes > kCacheBytes;
+                LOGI("Layer %d reaches %zu masks, storing all %zu%s", pc, extensions.size(),
+                     (size_t)1 << N, layered ? " by layer" : "");
+                table->make_dense(layered);
+                std::vector<uint32_t>().swap(next_steps);
+                std::vector<uint64_t>().swap(extension_bits);
+            } else {
+                layer_first = table->slot_mask.size();
+                for (uint32_t mask : extensions) {
+                    table->index.insert(mask, (uint32_t)table->slot_mask.size());
+                    table->slot_mask.push_back(mask);
+                }
+                table->resize_slots(stored);
+                layer_size = extensions.size();
+                next_steps.assign(layer_size, 0);
+            }
+        }
+        bool sparse = table->sparse;
+        bool ranked = table->ranked;
+        bool last_layer = pc == N;
+        uint32_t n_chunks = (uint32_t)((layer_size + chunk_size - 1) / chunk_size);
+        queues.reset(n_chunks);
+        layer_finishes.store(false, std::memory_order_relaxed);
+        workers.run([&](int worker) {
+            uint32_t chunk;
+            while (!stop.load(std::memory_order_relaxed) && queues.next(worker, &chunk)) {
+                if (ws->should_stop()) {
+                    stop.store(true, std::memory_order_relaxed);
+                    break;
+                }
+                uint64_t first = (uint64_t)chunk * chunk_size;
+                uint64_t count = std::min(chunk_size, layer_size - first);
+                if (sparse) {
+                    for (size_t slot = layer_first + first; slot < layer_first + first + count; slot++) {
+                        relax_mask(table->slot_mask[slot], slot, last_layer,
+                                   &worker_counters[worker].c);
+                    }
+                    continue;
+                }
+                int mask = kBinomials.unrank(first, pc);
+                size_t slot = table->layer_start[pc] + first;
+                for (uint64_t k = 0; k < count; k++) {
+                    relax_mask(mask, ranked ? slot + k : (size_t)mask, last_layer,
+                               &worker_counters[worker].c);
+                    mask = next_combination(mask);
+                }
+            }
+        });
+        if (stop.load(std::memory_order_relaxed)) {
+            LOGI("Stopped in layer %d of %d", pc, N);
+            break;
+        }
+        if (layer_finishes.load(std::memory_order_relaxed)) best_count = pc;
+        if (ws->progress) ws->progress(SolveProgress{pc, N, best_count});
+    }
+    COUNT(for (const WorkerCounters& w : worker_counters) add_counters(w.c, counters);)
+    COUNT(clock.lap(&counters->layers_ms);)
+    table->complete = !stop.load(std::memory_order_relaxed);
+    return table->complete;
+}
+
+// Best route of one lane for each exclusion set: the most checkpoints,
+// then the earliest finish, over states whose visited set avoids
+// excluded[q]. Masks of each size and positions are scanned in increasing
+// order with strict comparisons, and dropping checkpoints from the problem keeps both
+// orders and every leg among the rest, so each answer is exactly what a
+// solve with those checkpoints removed would return, in full indices.
+//
+// Routes are walked back without stored parents: the predecessor of a
+// reached (mask, j) is the position the pull kernel picks from row
+// mask ^ j, which is deterministic, so re-running it gives the same i the
+// DP chose when it wrote the state. With SOLVER_COUNTERS defined and
+// counters set, the scan and the walks are timed into it.
+static void best_routes(const DpTable& table, int lane, const int* excluded, int n_queries,
+                        SolverResult* results,
+                        [[maybe_unused]] SolveCounters* counters = nullptr) {
+    COUNT(PhaseClock clock;)
+    int N = table.n_checkpoints;
+    const std::vector<float>& depart_limit = table.depart_limit[lane];
+    const std::vector<float>& finish_travel = table.finish_travel[lane];
+
+    struct Best {
+        int count;
+        float finish_time;
+        int mask;
+        int last;
+    };
+    std::vector<Best> best(n_queries, Best{-1, INF_TIME, -1, -1});
+    alignas(32) float buf[MAX_STRIDE];
+
+    int mask = 0;
+    for (size_t slot = 1; slot < table.n_slots(); slot++) {
+        if (table.sparse) mask = (int)table.slot_mask[slot];
+        else if (table.ranked) mask = next_layered_mask(mask, N);
+        else mask = (int)slot;
+        if (!((table.live[slot] >> lane) & 1)) continue;
+        int count = popcount(mask);
+        const float* dp_row = table.slot_floats(slot, lane, buf);
+        for (int i = 0; i < N; i++) {
+            // Unreached states are INF_TIME and fail the deadline check
+            if (dp_row[i] > depart_limit[i]) continue;
+            float finish_arr = dp_row[i] + finish_travel[i];
+            float actual_finish = finish_time_at(table.open_table, finish_arr);
+
+            for (int q = 0; q < n_queries; q++) {
+                if (mask & excluded[q]) continue;
+                Best& b = best[q];
+                if ((count > b.count) ||
+                    (count == b.count && actual_finish < b.finish_time)) {
+                    b = Best{count, actual_finish, mask, i};
+                }
+            }
+        }
+    }
+    COUNT(if (counters) clock.lap(&counters->best_scan_ms);)
+
+    for (int q = 0; q < n_queries; q++) {
+        SolverResult* result = &results[q];
+        // A stopped pass proves nothing about the layers it missed
+        result->count_bound = table.complete ? std::max(best[q].count, 0)
+                                             : N - popcount(excluded[q]);
+        if (best[q].count < 0) {
+            result->count = 0;
+            result->route.clear();
+            result->finish_time = 0.0f;
+            continue;
+        }
+
+        // Reconstruct route
+        std::vector<int> route_buf;
+        route_buf.reserve(N);
+        int cur_mask = best[q].mask;
+        int cur_pos = best[q].last;
+
+        while (true) {
+            route_buf.push_back(cur_pos);
+            int prev_mask = cur_mask ^ (1 << cur_pos);
+            if (prev_mask == 0) {
+                // Came from Start
+                break;
+            }
+            float depart;
+            int prev_pos = kPullKernel(table.legs[lane], table.row_floats(prev_mask, lane, buf),
+                                       cur_pos, &depart);
+            if (prev_pos < 0) {
+                // Should not happen
+                LOGE("Route chain broken at mask=%d pos=%d", cur_mask, cur_pos);
+                break;
+            }
+            cur_mask = prev_mask;
+            cur_pos = prev_pos;
+        }
+
+        // Reverse the route
+        result->count = best[q].count;
+        result->finish_time = best[q].finish_time;
+        result->route.assign(route_buf.rbegin(), route_buf.rend());
+    }
+    COUNT(if (counters) clock.lap(&counters->reconstruct_ms);)
+}
+
+// Timeline of one lane's route from Start to Finish, replayed through the
+// lane's leg table so every departure is the one the DP stored. Nodes use
+// the DP's layout: Start is N and Finish N+1.
+static void route_timeline(const DpTable& table, int lane, float start_time,
+                           const std::vector<int>& route, std::vector<Stop>* stops) {
+    int N = table.n_checkpoints;
+    const LegTable& lt = table.legs[lane];
+    stops->clear();
+    if (route.empty()) return;
+
+    stops->push_back(Stop{N, start_time, start_time});
+    int from = N;
+    float depart = start_time;
+    for (int j : route) {
+        float arrival = depart + lt.leg(from, j).travel;
+        depart = take_leg(lt, from, j, depart);
+        stops->push_back(Stop{j, arrival, depart});
+        from = j;
+    }
+    float finish_arrival = depart + table.finish_travel[lane][from];
+    stops->push_back(Stop{N + 1, finish_arrival, finish_time_at(table.open_table, finish_arrival)});
+}
+
+// Finish time of route replayed in floats through the lane's leg table,
+// or INF_TIME if a window closes on it. A seconds table rounds departures
+// down, so its routes hold only once they replay.
+static float replay_finish(const DpTable& table, int lane, float start_time,
+                           const std::vector<int>& route) {
+    int from = table.n_checkpoints;
+    float depart = start_time;
+    for (int j : route) {
+        depart = take_leg(table.legs[lane], from, j, depart);
+        if (depart >= INF_TIME) return INF_TIME;
+        from = j;
+    }
+    if (depart > table.depart_limit[lane][from]) return INF_TIME;
+    return finish_time_at(table.open_table, depart + table.finish_travel[lane][from]);
+}
+
+static inline uint32_t float_bits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof bits);
+    return bits;
+}
+
+static inline float bits_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+// ── Meet in the middle ──────────────────────────────────────────────
+//
+// Past MAX_DENSE_CP checkpoints the mask lattice is too large to fill, so
+// a solve searches from both ends of the day instead. A forward label
+// (S, m) is the earliest departure from m after visiting S from Start,
+// ending at m, exactly as dp holds it. A backward label (T, m) is the
+// latest departure from m from which T, starting at m, can be walked in
+// some order to Finish under the same rules. Forward labels are extended
+// while they leave by the meeting time and backward labels while they
+// leave after it, so every route has a checkpoint m, the last it leaves
+// by the meeting time (or its first), where both halves are labelled. A
+// forward (S, m) and a backward (T, m) join into a route of
+// |S| + |T| - 1 checkpoints when S and T share only m and the forward
+// departure is no later than the backward one.
+//
+// Joins give the most checkpoints. The earliest finish among those routes
+// is then found by searching the Finish arrival deadline the backward
+// labels are built for, as solve_frontier searches speeds.
+
+// Where between Start and the last Finish arrival the halves meet.
+// Backward labels are only pruned by earliest departures, so the halves
+// balance past the middle of the day.
+static const float MEET_FRACTION = 0.6f;
+
+// Half a route: the checkpoints it visits, the one it leaves from and the
+// departure there.
+struct Label {
+    uint32_t mask;
+    int pos;
+    float time;
+};
+
+static inline bool label_key_less(const Label& a, const Label& b) {
+    return a.mask != b.mask ? a.mask < b.mask : a.pos < b.pos;
+}
+
+// Sorts labels by (mask, pos) and keeps the earliest time of each pair,
+// or the latest with keep_latest. The sort is an LSD radix sort on the
+// 37-bit key mask << 5 | pos, skipping digits that every key shares.
+static void merge_labels(std::vector<Label>* labels, bool keep_latest) {
+    std::vector<Label>& a = *labels;
+    auto key = [](const Label& label) { return (uint64_t)label.mask << 5 | (uint64_t)label.pos; };
+    uint64_t any_set = 0, all_set = ~(uint64_t)0;
+    for (const Label& label : a) {
+        any_set |= key(label);
+        all_set &= key(label);
+    }
+    std::vector<Label> b(a.size());
+    for (int shift = 0; shift < 37; shift += 8) {
+        if ((((any_set ^ all_set) >> shift) & 0xFF) == 0) continue;
+        size_t start[257] = {0};
+        for (const Label& label : a) start[((key(label) >> shift) & 0xFF) + 1]++;
+        for (int d = 0; d < 256; d++) start[d + 1] += start[d];
+        for (const Label& label : a) b[start[(key(label) >> shift) & 0xFF]++] = label;
+        a.swap(b);
+    }
+
+    size_t kept = 0;
+    for (size_t k = 0; k < a.size(); k++) {
+        if (kept > 0 && a[kept - 1].mask == a[k].mask && a[kept - 1].pos == a[k].pos) {
+            float& time = a[kept - 1].time;
+            time = keep_latest ? std::max(time, a[k].time) : std::min(time, a[k].time);
+        } else {
+            a[kept++] = a[k];
+        }
+    }
+    a.resize(kept);
+}
+
+// The label of (mask, pos) in a merged layer, or null.
+static const Label* find_label(const std::vector<Label>& layer, uint32_t mask, int pos) {
+    auto it = std::lower_bound(layer.begin(), layer.end(), Label{mask, pos, 0.0f}, label_key_less);
+    return it != layer.end() && it->mask == mask && it->pos == pos ? &*it : nullptr;
+}
+
+// Latest arrival at j that still leaves j by depart_by, or -INF_TIME if
+// none does. Leaving j is non-decreasing in the arrival, so every earlier
+// feasible arrival also works.
+static float latest_arrival(const LegTable& lt, int j, float depart_by) {
+    const float* ready = &lt.ready[(size_t)j * lt.span];
+    int last = (int)(std::upper_bound(ready, ready + lt.span, depart_by) - ready) - 1;
+    if (last < 0 || lt.arrival_limit[j] <= -INF_TIME) return -INF_TIME;
+    float by_window = std::nextafter((float)(lt.base + last + 1), -INFINITY);
+    return std::min(std::min(lt.arrival_limit[j], by_window), latest_start(lt.dwell, depart_by));
+}
+
+// Earliest departure from each checkpoint over any walk from Start,
+// revisits allowed, which bounds every forward label from below. Leaving
+// later never arrives earlier, so N - 1 rounds of relaxation settle it.
+static void earliest_departures(const LegTable& lt, float start_time, std::vector<float>* earliest) {
+    int N = lt.n_checkpoints;
+    std::vector<float>& e = *earliest;
+    e.resize(N);
+    for (int j = 0; j < N; j++) e[j] = take_leg(lt, N, j, start_time);
+    for (int round = 1; round < N; round++) {
+        bool changed = false;
+        for (int i = 0; i < N; i++) {
+            if (e[i] >= INF_TIME) continue;
+            for (int j = 0; j < N; j++) {
+                float t = take_leg(lt, i, j, e[i]);
+                if (t < e[j]) {
+                    e[j] = t;
+                    changed = true;
+                }
+            }
+        }
+        if (!changed) break;
+    }
+}
+
+// A label as join_halves() sees it at its checkpoint.
+struct JoinEntry {
+    uint32_t mask;
+    float time;
+    int size;   // checkpoints in mask
+};
+
+// Both halves of one solve. forward[s] and backward[t] are merged layers
+// of labels over s and t checkpoints; layer 0 is empty.
+struct Halves {
+    float meet;                         // meeting time
+    std::vector<float> earliest;        // per checkpoint, from earliest_departures()
+    std::vector<float> forward_min;     // per checkpoint, earliest forward label there
+    std::vector<std::vector<Label>> forward;
+    std::vector<std::vector<Label>> backward;
+    std::vector<std::vector<JoinEntry>> forward_at;    // per checkpoint, larger sets first
+
+    size_t bytes() const {
+        size_t n = 0;
+        for (const std::vector<Label>& layer : forward) n += layer.capacity();
+        for (const std::vector<Label>& layer : backward) n += layer.capacity();
+        return n * sizeof(Label);
+    }
+};
+
+// One joined route: forward label (forward_mask, m) and backward label
+// (backward_mask, m).
+struct Join {
+    int count;
+    int m;
+    uint32_t forward_mask;
+    uint32_t backward_mask;
+};
+
+// Runs extend(label, &out) on every label of `from`, which appends the
+// labels one checkpoint longer to out, sharing the labels out among the
+// workers, and merges the results into *to. False if the workspace
+// stopped the pass.
+template <typename Extend>
+static bool extend_layer(const std::vector<Label>& from, Extend extend, bool keep_latest,
+                         WorkerPool& workers, Workspace* ws, std::vector<Label>* to) {
+    const size_t chunk_size = 1024;
+    size_t n_chunks = (from.size() + chunk_size - 1) / chunk_size;
+    std::vector<std::vector<Label>> found(workers.size());
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<bool> stop{false};
+    workers.run([&](int worker) {
+        std::vector<Label>& out = found[worker];
+        size_t chunk;
+        while (!stop.load(std::memory_order_relaxed) &&
+               (chunk = next_chunk.fetch_add(1, std::memory_order_relaxed)) < n_chunks) {
+            if (ws->should_stop()) {
+                stop.store(true, std::memory_order_relaxed);
+                break;
+            }
+            size_t end = std::min(from.size(), (chunk + 1) * chunk_size);
+            for (size_t k = chunk * chunk_size; k < end; k++) extend(from[k], &out);
+        }
+    });
+    to->clear();
+    for (std::vector<Label>& out : found) to->insert(to->end(), out.begin(), out.end());
+    merge_labels(to, keep_latest);
+    return !stop.load(std::memory_order_relaxed);
+}
+
+// Forward labels from Start, extended while they leave by h->meet. Only
+// labels leaving by then are kept past the first layer: the others are
+// never the forward half of a join. Reports progress per layer, counting
+// every forward label as a route, since each can walk straight to Finish.
+static bool build_forward(const DpTable& tables, float start_time, Halves* h, WorkerPool& workers,
+                          Workspace* ws, [[maybe_unused]] SolveCounters* counters) {
+    const LegTable& lt = tables.legs[0];
+    int N = tables.n_checkpoints;
+    h->forward.assign(2, {});
+    for (int j = 0; j < N; j++) {
+        float t = take_leg(lt, N, j, start_time);
+        if (t < INF_TIME) h->forward[1].push_back(Label{1u << j, j, t});
+    }
+    merge_labels(&h->forward[1], false);
+    COUNT(counters->reached[1] += h->forward[1].size();)
+    int best_count = h->forward[1].empty() ? 0 : 1;
+    if (ws->progress) ws->progress(SolveProgress{1, N, best_count});
+
+    float meet = h->meet;
+    for (int s = 2; s <= N && !h->forward[s - 1].empty(); s++) {
+        std::vector<Label> layer;
+        auto extend = [&](const Label& label, std::vector<Label>* out) {
+            if (label.time > meet) return;
+            for (int j = 0; j < N; j++) {
+                if ((label.mask >> j) & 1) continue;
+                float t = take_leg(lt, label.pos, j, label.time);
+                if (t <= meet) out->push_back(Label{label.mask | 1u << j, j, t});
+            }
+        };
+        bool finished = extend_layer(h->forward[s - 1], extend, false, workers, ws, &layer);
+        if (!finished) return false;
+        if (layer.empty()) break;
+        COUNT(counters->reached[s] += layer.size();)
+        h->forward.push_back(std::move(layer));
+        best_count = s;
+        if (ws->progress) ws->progress(SolveProgress{s, N, best_count});
+    }
+
+    h->forward_min.assign(N, INF_TIME);
+    h->forward_at.assign(N, {});
+    for (int s = (int)h->forward.size() - 1; s >= 1; s--) {
+        for (const Label& label : h->forward[s]) {
+            h->forward_min[label.pos] = std::min(h->forward_min[label.pos], label.time);
+            h->forward_at[label.pos].push_back(JoinEntry{label.mask, label.time, s});
+        }
+    }
+    return true;
+}
+
+// Backward labels towards a Finish arrival of at most deadline, extended
+// while they leave after h->meet. A label is kept if it is extended or if
+// a forward label could join it; none earlier than h->earliest can be
+// reached at all.
+static bool build_backward(const DpTable& tables, float deadline, Halves* h, WorkerPool& workers,
+                           Workspace* ws, [[maybe_unused]] SolveCounters* counters) {
+    const LegTable& lt = tables.legs[0];
+    const std::vector<float>& depart_limit = tables.depart_limit[0];
+    const std::vector<float>& finish_travel = tables.finish_travel[0];
+    int N = tables.n_checkpoints;
+    float meet = h->meet;
+    auto keep = [&](int j, float dep) {
+        return dep >= h->earliest[j] && (dep > meet || dep >= h->forward_min[j]);
+    };
+
+    h->backward.assign(2, {});
+    for (int j = 0; j < N; j++) {
+        float dep = std::min(depart_limit[j], latest_start(finish_travel[j], deadline));
+        if (keep(j, dep)) h->backward[1].push_back(Label{1u << j, j, dep});
+    }
+    COUNT(counters->reached[1] += h->backward[1].size();)
+
+    for (int t = 2; t <= N && !h->backward[t - 1].empty(); t++) {
+        std::vector<Label> layer;
+        auto extend = [&](const Label& label, std::vector<Label>* out) {
+            if (label.time <= meet) return;
+            float arrival = latest_arrival(lt, label.pos, label.time);
+            if (arrival <= -INF_TIME) return;
+            for (int i = 0; i < N; i++) {
+                if ((label.mask >> i) & 1) continue;
+                float dep = latest_start(lt.leg(i, label.pos).travel, arrival);
+                if (keep(i, dep)) out->push_back(Label{label.mask | 1u << i, i, dep});
+            }
+        };
+        bool finished = extend_layer(h->backward[t - 1], extend, true, workers, ws, &layer);
+        if (!finished) return false;
+        if (layer.empty()) break;
+        COUNT(counters->reached[t] += layer.size();)
+        h->backward.push_back(std::move(layer));
+    }
+    return true;
+}
+
+// Best join of at least min_count checkpoints, or count 0 if there is
+// none. With first_only any such join will do. Pairs are tried per
+// meeting checkpoint, forward labels by falling size against backward
+// labels by falling size and then falling departure, so each forward
+// label stops at the first backward label that joins it or that leaves
+// too early. False if the workspace stopped the search; *best then holds
+// the best join so far.
+static bool join_halves(const Halves& h, int N, int min_count, bool first_only, Workspace* ws,
+                        Join* best) {
+    *best = Join{0, -1, 0, 0};
+    // Backward labels per checkpoint, larger sets first. Each run of one
+    // size is sorted by falling departure the first time it is scanned.
+    struct Run {
+        int size;
+        size_t begin, end;
+        bool sorted;
+    };
+    std::vector<std::vector<JoinEntry>> backward_at(N);
+    std::vector<std::vector<Run>> runs_at(N);
+    for (int t = (int)h.backward.size() - 1; t >= 1; t--) {
+        for (const Label& label : h.backward[t]) {
+            std::vector<JoinEntry>& back = backward_at[label.pos];
+            std::vector<Run>& runs = runs_at[label.pos];
+            if (runs.empty() || runs.back().size != t) runs.push_back(Run{t, back.size(), back.size(), false});
+            back.push_back(JoinEntry{label.mask, label.time, t});
+            runs.back().end++;
+        }
+    }
+
+    int need = min_count;   // smallest count still worth finding
+    for (int m = 0; m < N; m++) {
+        std::vector<JoinEntry>& back = backward_at[m];
+        std::vector<Run>& runs = runs_at[m];
+        if (back.empty()) continue;
+        uint32_t m_bit = 1u << m;
+
+        const std::vector<JoinEntry>& forward = h.forward_at[m];
+        for (size_t n = 0; n < forward.size(); n++) {
+            const JoinEntry& f = forward[n];
+            if (f.size + runs.front().size - 1 < need) break;
+            if (n % 4096 == 0 && ws->should_stop()) return false;
+            bool joined = false;
+            for (Run& run : runs) {
+                if (f.size + run.size - 1 < need) break;
+                if (!run.sorted) {
+                    std::sort(back.begin() + run.begin, back.begin() + run.end,
+                              [](const JoinEntry& a, const JoinEntry& b) { return a.time > b.time; });
+                    run.sorted = true;
+                }
+                // Up to the first label of this size that leaves too early
+                for (size_t k = run.begin; k < run.end && back[k].time >= f.time; k++) {
+                    if ((f.mask & back[k].mask) != m_bit) continue;
+                    *best = Join{f.size + run.size - 1, m, f.mask, back[k].mask};
+                    joined = true;
+                    break;
+                }
+                if (joined) break;
+            }
+            if (!joined) continue;
+            if (first_only) return true;
+            need = best->count + 1;
+        }
+    }
+    return true;
+}
+
+// The route of a join: the forward half walked back from its label, each
+// step to the lowest predecessor that gives the stored departure, then
+// the backward half walked on from m, each step to the lowest checkpoint
+// whose label the departure so far still meets.
+static void join_route(const DpTable& tables, const Halves& h, const Join& join,
+                       std::vector<int>* route) {
+    const LegTable& lt = tables.legs[0];
+    route->clear();
+    uint32_t mask = join.forward_mask;
+    int pos = join.m;
+    float depart = find_label(h.forward[popcount(mask)], mask, pos)->time;
+    float depart_m = depart;
+    while (true) {
+        route->push_back(pos);
+        uint32_t prev = mask ^ (1u << pos);
+        if (!prev) break;
+        int prev_pos = -1;
+        for (uint32_t rest = prev; rest; rest &= rest - 1) {
+            int i = __builtin_ctz(rest);
+            const Label* label = find_label(h.forward[popcount(prev)], prev, i);
+            if (label && take_leg(lt, i, pos, label->time) == depart) {
+                prev_pos = i;
+                depart = label->time;
+                break;
+            }
+        }
+        if (prev_pos < 0) {
+            LOGE("Forward route broken at mask=%u pos=%d", mask, pos);
+            break;
+        }
+        mask = prev;
+        pos = prev_pos;
+    }
+    std::reverse(route->begin(), route->end());
+
+    uint32_t rest = join.backward_mask ^ (1u << join.m);
+    pos = join.m;
+    depart = depart_m;
+    while (rest) {
+        int next = -1;
+        for (uint32_t left = rest; left; left &= left - 1) {
+            int k = __builtin_ctz(left);
+            const Label* label = find_label(h.backward[popcount(rest)], rest, k);
+            float t = take_leg(lt, pos, k, depart);
+            if (label && t <= label->time) {
+                next = k;
+                depart = t;
+                break;
+            }
+        }
+        if (next < 0) {
+            LOGE("Backward route broken at mask=%u pos=%d", rest, pos);
+            break;
+        }
+        route->push_back(next);
+        rest ^= 1u << next;
+        pos = next;
+    }
+}
+
+// Finish arrival of a route replayed from Start, or INF_TIME if it is
+// not feasible.
+static float route_arrival(const DpTable& tables, float start_time, const std::vector<int>& route) {
+    const LegTable& lt = tables.legs[0];
+    int from = tables.n_checkpoints;
+    float depart = start_time;
+    for (int j : route) {
+        depart = take_leg(lt, from, j, depart);
+        if (depart >= INF_TIME) return INF_TIME;
+        from = j;
+    }
+    if (route.empty() || depart > tables.depart_limit[0][from]) return INF_TIME;
+    return depart + tables.finish_travel[0][from];
+}
+
+// Solves one input by meeting in the middle. ws->table gets the leg
+// tables but no dp, so route_timeline() can replay the result. A stopped
+// solve returns its best route so far: the best join, or else the best
+// forward label walked straight to Finish.
+static void solve_meet(const SolverInput* input, SolverResult* result, Workspace* ws) {
+    COUNT(PhaseClock clock;)
+    SolveCounters counters{};
+    DpTable& tables = ws->table;
+    build_lane_tables(input, 1, &tables);
+    int N = input->n_checkpoints;
+    float start_time = (float)input->start_time;
+    float latest_arrival_at_finish = tables.open_table.latest_finish_arrival;
+    *result = SolverResult{0, {}, 0.0f};
+
+    Halves h;
+    h.meet = start_time + MEET_FRACTION * (latest_arrival_at_finish - start_time);
+    earliest_departures(tables.legs[0], start_time, &h.earliest);
+    WorkerPool& workers = pool_of_size(&ws->pool, resolve_thread_count(input->n_threads));
+    LOGI("Meet-in-the-middle solve: N=%d, speed=%.2f, meeting at %.1f, threads=%d",
+         N, input->speed, h.meet, workers.size());
+    COUNT(clock.lap(&counters.init_ms);)
+
+    // Labels made over all passes, and the most held at once
+    int64_t labels = 0;
+    size_t peak_bytes = 0;
+    auto note_labels = [&](const std::vector<std::vector<Label>>& half) {
+        for (const std::vector<Label>& layer : half) labels += layer.size();
+        peak_bytes = std::max(peak_bytes, h.bytes());
+    };
+
+    // Best route so far and its Finish arrival
+    std::vector<int> route;
+    float arrival = INF_TIME;
+    int count = 0;
+    auto take_join = [&](const Join& join) {
+        join_route(tables, h, join, &route);
+        arrival = route_arrival(tables, start_time, route);
+        count = join.count;
+    };
+
+    bool finished = latest_arrival_at_finish > -INF_TIME &&
+        build_forward(tables, start_time, &h, workers, ws, &counters);
+    note_labels(h.forward);
+    if (h.forward.size() > 1) {
+        // Until a join is found, the best forward label is the best route
+        int s = (int)h.forward.size() - 1;
+        const Label* best = nullptr;
+        float best_finish = INF_TIME;
+        for (const Label& label : h.forward[s]) {
+            float finish = label.time + tables.finish_travel[0][label.pos];
+            if (finish < best_finish) {
+                best = &label;
+                best_finish = finish;
+            }
+        }
+        if (best) take_join(Join{s, best->pos, best->mask, 1u << best->pos});
+    }
+
+    Join join{0, -1, 0, 0};
+    if (finished) {
+        finished = build_backward(tables, latest_arrival_at_finish, &h, workers, ws, &counters);
+        note_labels(h.backward);
+        COUNT(clock.lap(&counters.layers_ms);)
+        if (finished) finished = join_halves(h, N, count + 1, false, ws, &join);
+        if (join.count > count) take_join(join);
+    }
+
+    // Earliest Finish arrival among routes of `count` checkpoints: search
+    // the deadline over float bits, alternating probes just below the best
+    // arrival so far with midpoints, as solve_frontier does for speeds
+    int n_probes = 0;
+    uint32_t lo_bits = float_bits(start_time);  // nothing arrives by the start
+    bool probe_below_hi = true;
+    while (finished && count > 0 && arrival < INF_TIME && float_bits(arrival) - lo_bits > 1) {
+        uint32_t hi_bits = float_bits(arrival);
+        float probe = probe_below_hi ? bits_float(hi_bits - 1)
+                                     : bits_float(lo_bits + (hi_bits - lo_bits) / 2);
+        n_probes++;
+        finished = build_backward(tables, probe, &h, workers, ws, &counters);
+        note_labels(h.backward);
+        if (finished) finished = join_halves(h, N, count, true, ws, &join);
+        if (!finished) break;
+        if (join.count >= count) {
+            take_join(join);
+            probe_below_hi = !probe_below_hi;
+        } else {
+            lo_bits = float_bits(probe);
+            probe_below_hi = true;
+        }
+    }
+    COUNT(clock.lap(&counters.best_scan_ms);)
+    if (!finished) ws->stopped = true;
+
+    if (count > 0) {
+        result->count = count;
+        result->route = route;
+        result->finish_time = finish_time_at(tables.open_table, arrival);
+    }
+    result->count_bound = finished ? count : N;
+    if (ws->progress) ws->progress(SolveProgress{N, N, count});
+    LOGI("Meet in the middle: %d checkpoints, finish=%.1f, %lld labels, %d deadline probes%s",
+         count, result->finish_time, (long long)labels, n_probes, finished ? "" : ", stopped");
+    COUNT(log_counters(counters, N);)
+    ws->record_pass(labels, peak_bytes, counters);
+}
+
+// ── Branch and bound ────────────────────────────────────────────────
+//
+// A depth-first search over routes from Start, walking legs with the
+// same take_leg() and Finish rules as the DP, that holds only the route
+// it is extending. A node is a route prefix: its visited set, last
+// checkpoint and departure there. Children are tried earliest departure
+// first, so the first routes found are greedy ones, and a node is cut
+// once an optimistic count of what it could still add cannot beat the
+// best route so far, or can only tie it and cannot finish earlier.
+//
+// The count takes every unvisited checkpoint whose shortest walk from the
+// node, dwelling at each checkpoint passed but never waiting for a
+// window, arrives by its latest feasible arrival, and then only as many
+// of those as fit before the last Finish arrival, each costing its
+// shortest leg in from the node or another of them plus dwell. Neither
+// waits for windows or needs the legs to form a route, so neither
+// undercounts. A finished search proves its route optimal; a stopped one
+// reports the highest count among the nodes it left as count_bound.
+
+// Float sums along a walk may round away from the route's own sums, so
+// bounds are relaxed by this many minutes.
+static const float BOUND_SLACK = 1.0f / 64.0f;
+
+// Dominance table slots per checkpoint, as a power of two: 2^16 slots of
+// 8 bytes for each of up to MAX_CP checkpoints, 16 MB in all.
+static const int DOMINANCE_BITS = 16;
+
+// Route-independent parts of the bounds, from lane 0 of the tables.
+struct BoundTables {
+    int n_checkpoints;
+    float latest_arrival;           // last accepted Finish arrival
+    std::vector<float> reach;       // (N+1) x N, least walk from i (Start = N) to arriving at j
+};
+
+static void build_bound_tables(const DpTable& tables, BoundTables* b) {
+    const LegTable& lt = tables.legs[0];
+    int N = tables.n_checkpoints;
+    b->n_checkpoints = N;
+    b->latest_arrival = tables.open_table.latest_finish_arrival;
+
+    // Shortest walks, dwelling at each checkpoint passed through. Start
+    // is only ever a source, so it is a row but never a pivot.
+    std::vector<float>& reach = b->reach;
+    reach.resize((size_t)(N + 1) * N);
+    for (int i = 0; i <= N; i++) {
+        for (int j = 0; j < N; j++) reach[(size_t)i * N + j] = lt.leg(i, j).travel;
+    }
+    for (int k = 0; k < N; k++) {
+        const float* from_k = &reach[(size_t)k * N];
+        for (int i = 0; i <= N; i++) {
+            float* from_i = &reach[(size_t)i * N];
+            float via = from_i[k] + lt.dwell;
+            for (int j = 0; j < N; j++) from_i[j] = std::min(from_i[j], via + from_k[j]);
+        }
+    }
+}
+
+// Most checkpoints a prefix that has visited mask and leaves pos at
+// depart could still add. *arrival is a lower bound on its Finish
+// arrival with `needed` more (INF_TIME if it cannot add that many).
+static int extension_bound(const DpTable& tables, const BoundTables& b, uint32_t mask, int pos,
+                           float depart, int needed, float* arrival) {
+    const LegTable& lt = tables.legs[0];
+    const std::vector<float>& finish_travel = tables.finish_travel[0];
+    int N = b.n_checkpoints;
+    const float* reach = &b.reach[(size_t)pos * N];
+
+    uint32_t reachable = 0;
+    float last_leg = INF_TIME;
+    for (int j = 0; j < N; j++) {
+        if (((mask >> j) & 1) || depart + reach[j] > lt.arrival_limit[j] + BOUND_SLACK) continue;
+        reachable |= 1u << j;
+        last_leg = std::min(last_leg, finish_travel[j]);
+    }
+
+    // Cheapest way into each, from pos or another reachable checkpoint,
+    // in increasing order
+    float entry[MAX_CP];
+    int n_entries = 0;
+    for (uint32_t rest = reachable; rest; rest &= rest - 1) {
+        int j = __builtin_ctz(rest);
+        float in = lt.leg(pos, j).travel;
+        for (uint32_t from = reachable & ~(1u << j); from; from &= from - 1) {
+            in = std::min(in, lt.leg(__builtin_ctz(from), j).travel);
+        }
+        in += lt.dwell;
+        int k = n_entries++;
+        for (; k > 0 && entry[k - 1] > in; k--) entry[k] = entry[k - 1];
+        entry[k] = in;
+    }
+
+    *arrival = needed == 0 ? depart + finish_travel[pos] : INF_TIME;
+    float budget = b.latest_arrival + BOUND_SLACK - depart - last_leg;
+    float spent = 0.0f;
+    int extra = 0;
+    for (int k = 0; k < n_entries; k++) {
+        spent += entry[k];
+        if (spent > budget) break;
+        extra++;
+        if (extra == needed) *arrival = depart + spent + last_leg;
+    }
+    return extra;
+}
+
+// Best route found by any worker. key orders (count, earlier arrival) so
+// that workers can test against it without the lock.
+struct Incumbent {
+    std::atomic<uint64_t> key{0};
+    std::mutex mutex;
+    std::vector<int> route;
+
+    static uint64_t key_of(int count, float arrival) {
+        return (uint64_t)count << 32 | (uint32_t)~float_bits(arrival);
+    }
+
+    static int count_of(uint64_t key) { return (int)(key >> 32); }
+
+    static float arrival_of(uint64_t key) {
+        return key == 0 ? INF_TIME : bits_float(~(uint32_t)key);
+    }
+};
+
+// Prefixes already searched, by last checkpoint and a hash of the
+// visited set: each slot holds one visited set and the earliest departure
+// searched with it. Leaving the same checkpoint with the same set no
+// earlier is dominated, since legs are FIFO, so the search skips it. A
+// slot is one atomic word, so workers share the table without locks;
+// colliding sets just overwrite each other and cost some pruning.
+class DominanceTable {
+public:
+    explicit DominanceTable(int n_checkpoints)
+        : slots_((size_t)n_checkpoints << DOMINANCE_BITS) {}
+
+    // True if (mask, pos) has been searched leaving no later than depart;
+    // otherwise records this departure.
+    bool dominated(uint32_t mask, int pos, float depart) {
+        std::atomic<uint64_t>& slot = slots_[(size_t)pos << DOMINANCE_BITS | hash(mask)];
+        uint64_t seen = slot.load(std::memory_order_relaxed);
+        if ((uint32_t)(seen >> 32) == mask && bits_float((uint32_t)seen) <= depart) return true;
+        slot.store((uint64_t)mask << 32 | float_bits(depart), std::memory_order_relaxed);
+        return false;
+    }
+
+    size_t bytes() const { return slots_.size() * sizeof(uint64_t); }
+
+private:
+    static uint32_t hash(uint32_t mask) {
+        return (mask * 0x9E3779B1u) >> (32 - DOMINANCE_BITS);
+    }
+
+    std::vector<std::atomic<uint64_t>> slots_;
+};
+
+// A checkpoint to walk to next and the departure from it.
+struct Step {
+    int pos;
+    float depart;
+};
+
+// One worker's depth-first search.
+struct BranchSearch {
+    const DpTable* tables;
+    const BoundTables* bounds;
+    Incumbent* best;
+    DominanceTable* seen;
+    Workspace* ws;
+    int route[MAX_CP] = {};
+    int64_t nodes = 0;
+    bool stopped = false;
+    int open_bound = 0;     // most checkpoints of any node left unsearched
+    SolveCounters counters{};
+
+    // Searches below the prefix of count checkpoints ending at pos, whose
+    // first count - 1 are already in route. Once stopped, it only records
+    // the node's bound.
+    void search(uint32_t mask, int pos, float depart, int count) {
+        if ((++nodes & 1023) == 0 && !stopped && ws->should_stop()) stopped = true;
+        uint64_t key = best->key.load(std::memory_order_relaxed);
+        int best_count = Incumbent::count_of(key);
+        float arrival;
+        int extra = extension_bound(*tables, *bounds, mask, pos, depart,
+                                    std::max(best_count - count, 0), &arrival);
+        bool worth = count + extra > best_count ||
+            (count + extra == best_count && arrival - BOUND_SLACK < Incumbent::arrival_of(key));
+        if (stopped) {
+            if (worth) open_bound = std::max(open_bound, count + extra);
+            return;
+        }
+        if (!worth || seen->dominated(mask, pos, depart)) return;
+        COUNT(counters.reached[count]++;)
+
+        const LegTable& lt = tables->legs[0];
+        int N = tables->n_checkpoints;
+        route[count - 1] = pos;
+        if (depart <= tables->depart_limit[0][pos]) {
+            offer(count, depart + tables->finish_travel[0][pos]);
+        }
+
+        Step next[MAX_CP];
+        int n_next = 0;
+        for (int j = 0; j < N; j++) {
+            if ((mask >> j) & 1) continue;
+            COUNT(counters.transitions++;)
+            float t = take_leg(lt, pos, j, depart);
+            if (t >= INF_TIME) continue;
+            int k = n_next++;
+            for (; k > 0 && next[k - 1].depart > t; k--) next[k] = next[k - 1];
+            next[k] = Step{j, t};
+        }
+        for (int k = 0; k < n_next; k++) {
+            search(mask | 1u << next[k].pos, next[k].pos, next[k].depart, count + 1);
+        }
+    }
+
+    void offer(int count, float arrival) {
+        uint64_t key = Incumbent::key_of(count, arrival);
+        if (key <= best->key.load(std::memory_order_relaxed)) return;
+        std::lock_guard<std::mutex> lock(best->mutex);
+        if (key <= best->key.load(std::memory_order_relaxed)) return;
+        best->route.assign(route, route + count);
+        best->key.store(key, std::memory_order_relaxed);
+    }
+};
+
+// Solves one input by branch and bound, one task per first checkpoint,
+// shared out among the workers. ws->table gets the leg tables but no dp,
+// so route_timeline() can replay the result. A stopped solve returns the
+// best route found, with count_bound covering the nodes it left.
+static void solve_branch_bound(const SolverInput* input, SolverResult* result, Workspace* ws) {
+    COUNT(PhaseClock clock;)
+    SolveCounters counters{};
+    DpTable& tables = ws->table;
+    build_lane_tables(input, 1, &tables);
+    int N = input->n_checkpoints;
+    float start_time = (float)input->start_time;
+    BoundTables bounds;
+    build_bound_tables(tables, &bounds);
+    *result = SolverResult{0, {}, 0.0f};
+
+    std::vector<Step> firsts;
+    for (int j = 0; j < N; j++) {
+        float t = take_leg(tables.legs[0], N, j, start_time);
+        if (t < INF_TIME) firsts.push_back(Step{j, t});
+    }
+    std::stable_sort(firsts.begin(), firsts.end(),
+                     [](const Step& x, const Step& y) { return x.depart < y.depart; });
+    int n_tasks = (int)firsts.size();
+
+    WorkerPool& workers = pool_of_size(&ws->pool, resolve_thread_count(input->n_threads));
+    LOGI("Branch and bound: N=%d, speed=%.2f, %d first checkpoints, threads=%d",
+         N, input->speed, n_tasks, workers.size());
+    COUNT(clock.lap(&counters.init_ms);)
+
+    Incumbent best;
+    DominanceTable seen(N);
+    std::vector<BranchSearch> searches(workers.size(),
+                                       BranchSearch{&tables, &bounds, &best, &seen, ws});
+    std::atomic<int> next_task{0};
+    std::atomic<int> tasks_done{0};
+    workers.run([&](int worker) {
+        BranchSearch& search = searches[worker];
+        int task;
+        while ((task = next_task.fetch_add(1, std::memory_order_relaxed)) < n_tasks) {
+            const Step& first = firsts[task];
+            search.search(1u << first.pos, first.pos, first.depart, 1);
+            int done = tasks_done.fetch_add(1, std::memory_order_relaxed) + 1;
+            // Progress goes out on the calling thread only
+            if (worker == 0 && ws->progress) {
+                int best_count = Incumbent::count_of(best.key.load(std::memory_order_relaxed));
+                ws->progress(SolveProgress{done, n_tasks, best_count});
+            }
+        }
+    });
+    COUNT(clock.lap(&counters.layers_ms);)
+
+    bool finished = true;
+    int open_bound = 0;
+    int64_t nodes = 0;
+    for (const BranchSearch& search : searches) {
+        finished &= !search.stopped;
+        open_bound = std::max(open_bound, search.open_bound);
+        nodes += search.nodes;
+        COUNT(add_counters(search.counters, &counters);)
+    }
+    if (!finished) ws->stopped = true;
+
+    int count = Incumbent::count_of(best.key.load(std::memory_order_relaxed));
+    if (count > 0) {
+        result->count = count;
+        result->route = best.route;
+        float arrival = route_arrival(tables, start_time, best.route);
+        result->finish_time = finish_time_at(tables.open_table, arrival);
+    }
+    // Nothing beats what Start itself allows, however little was searched
+    float unused;
+    int from_start = extension_bound(tables, bounds, 0, N, start_time, 1, &unused);
+    result->count_bound = std::max(count, std::min(open_bound, from_start));
+    if (ws->progress) ws->progress(SolveProgress{n_tasks, n_tasks, count});
+    LOGI("Branch and bound: %d checkpoints, finish=%.1f, %lld nodes%s",
+         count, result->finish_time, (long long)nodes,
+         finished ? "" : ", stopped");
+    if (!finished) LOGI("Branch and bound stopped: no route has more than %d checkpoints",
+                        result->count_bound);
+    COUNT(log_counters(counters, N);)
+    ws->record_pass(nodes, seen.bytes(), counters);
+}
+
+// ── Label setting ───────────────────────────────────────────────────
+//
+// Settles route prefixes from Start ("labels": visited set, last
+// checkpoint, departure there) in order of departure, walking legs with
+// the same take_leg() and Finish rules as the DP, and drops a label if
+// one settled before it covers it: same last checkpoint, no later
+// departure, and a visited set containing its own. Where the sets are
+// equal that is the FIFO dominance the DP relies on. Where the settled
+// set has extra checkpoints, every route on from the new label is
+// matched by one that walks past them, which needs skipping a checkpoint
+// never to arrive anywhere later: travel(a, c) must not exceed
+// travel(a, b) + dwell + travel(b, c). Measured travel times mostly obey
+// that but not always, so each solve checks it per checkpoint b and only
+// those that pass may be the extras. Only a label's own checkpoint count
+// and the layers above it can hold a cover, so settled sets are kept in
+// lists per checkpoint and count and scanned with kSupersetKernel.
+//
+// Settled labels that cannot beat the best route so far, by the branch
+// and bound count, still cover later labels but are not extended. The
+// search runs on one thread.
+
+// Settled (mask, pos) states, open addressing on mask << 5 | pos. Keys
+// are stored plus one so that zero marks an empty slot.
+class StateSet {
+public:
+    StateSet() : slots_(1024, 0), shift_(64 - 10) {}
+
+    bool contains(uint32_t mask, int pos) const {
+        uint64_t key = key_of(mask, pos);
+        for (size_t s = slot_of(key);; s = (s + 1) & (slots_.size() - 1)) {
+            if (slots_[s] == key) return true;
+            if (slots_[s] == 0) return false;
+        }
+    }
+
+    // Adds a state that is not yet in the set.
+    void insert(uint32_t mask, int pos) {
+        if (2 * (size_ + 1) > slots_.size()) grow();
+        place(key_of(mask, pos));
+        size_++;
+    }
+
+    size_t bytes() const { return slots_.capacity() * sizeof(uint64_t); }
+
+private:
+    static uint64_t key_of(uint32_t mask, int pos) { return ((uint64_t)mask << 5 | pos) + 1; }
+
+    size_t slot_of(uint64_t key) const { return (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift_); }
+
+    void place(uint64_t key) {
+        size_t s = slot_of(key);
+        while (slots_[s] != 0) s = (s + 1) & (slots_.size() - 1);
+        slots_[s] = key;
+    }
+
+    void grow() {
+        std::vector<uint64_t> old(slots_.size() * 2, 0);
+        old.swap(slots_);
+        shift_--;
+        for (uint64_t key : old) {
+            if (key != 0) place(key);
+        }
+    }
+
+    std::vector<uint64_t> slots_;
+    int shift_;
+    size_t size_ = 0;
+};
+
+// A label waiting to be settled. parent indexes the settled label it
+// extends, -1 for Start.
+struct PendingLabel {
+    float depart;
+    uint32_t mask;
+    int pos;
+    int parent;
+};
+
+// Heap order: the earliest departure on top.
+static inline bool departs_later(const PendingLabel& a, const PendingLabel& b) {
+    return a.depart > b.depart;
+}
+
+// Pending labels by whole minute of departure. A leg never departs
+// earlier than the label it extends, so pushes land in the minute being
+// settled or a later one: that minute is kept as a heap and later ones
+// as plain lists, heaped once they are reached.
+class DepartureQueue {
+public:
+    DepartureQueue(int base, int span) : base_(base), minutes_(span) {}
+
+    bool empty() const { return size_ == 0; }
+
+    void push(const PendingLabel& label) {
+        int w = (int)label.depart - base_;
+        std::vector<PendingLabel>& minute = minutes_[w];
+        minute.push_back(label);
+        if (w == current_) std::push_heap(minute.begin(), minute.end(), departs_later);
+        size_++;
+    }
+
+    // Removes the earliest pending label; the queue must not be empty.
+    PendingLabel pop() {
+        while (minutes_[current_].empty()) {
+            std::vector<PendingLabel>().swap(minutes_[current_]);
+            std::vector<PendingLabel>& next = minutes_[++current_];
+            std::make_heap(next.begin(), next.end(), departs_later);
+        }
+        std::vector<PendingLabel>& minute = minutes_[current_];
+        std::pop_heap(minute.begin(), minute.end(), departs_later);
+        PendingLabel label = minute.back();
+        minute.pop_back();
+        size_--;
+        return label;
+    }
+
+    size_t bytes() const {
+        size_t bytes = 0;
+        for (const std::vector<PendingLabel>& minute : minutes_) {
+            bytes += minute.capacity() * sizeof(PendingLabel);
+        }
+        return bytes;
+    }
+
+private:
+    int base_;
+    std::vector<std::vector<PendingLabel>> minutes_;
+    int current_ = 0;
+    size_t size_ = 0;
+};
+
+struct SettledLabel {
+    uint32_t mask;
+    int pos;
+    int parent;
+};
+
+// Checkpoints that a covering label may have visited beyond the covered
+// one: skipping them on any walk from a checkpoint a to a checkpoint or
+// Finish c, dwell included, arrives at c no later, by BOUND_SLACK so that
+// float rounding along a route cannot undo it.
+static uint32_t skippable_checkpoints(const DpTable& tables) {
+    const LegTable& lt = tables.legs[0];
+    const std::vector<float>& finish_travel = tables.finish_travel[0];
+    int N = tables.n_checkpoints;
+    uint32_t skippable = 0;
+    for (int b = 0; b < N; b++) {
+        bool ok = true;
+        for (int a = 0; a < N && ok; a++) {
+            if (a == b) continue;
+            float into_b = lt.leg(a, b).travel + lt.dwell;
+            ok = finish_travel[a] + BOUND_SLACK <= into_b + finish_travel[b];
+            for (int c = 0; c < N && ok; c++) {
+                if (c == a || c == b) continue;
+                ok = lt.leg(a, c).travel + BOUND_SLACK <= into_b + lt.leg(b, c).travel;
+            }
+        }
+        if (ok) skippable |= 1u << b;
+    }
+    return skippable;
+}
+
+// Solves one input by label setting. ws->table gets the leg tables but
+// no dp, so route_timeline() can replay the result. A stopped solve
+// returns the best route settled so far.
+static void solve_label_setting(const SolverInput* input, SolverResult* result, Workspace* ws) {
+    COUNT(PhaseClock clock;)
+    SolveCounters counters{};
+    DpTable& tables = ws->table;
+    build_lane_tables(input, 1, &tables);
+    const LegTable& lt = tables.legs[0];
+    const std::vector<float>& depart_limit = tables.depart_limit[0];
+    const std::vector<float>& finish_travel = tables.finish_travel[0];
+    int N = input->n_checkpoints;
+    float start_time = (float)input->start_time;
+    BoundTables bounds;
+    build_bound_tables(tables, &bounds);
+    *result = SolverResult{0, {}, 0.0f};
+
+    uint32_t skippable = skippable_checkpoints(tables);
+    LOGI("Label setting: N=%d, speed=%.2f, %d of %d checkpoints skippable",
+         N, input->speed, popcount((int)skippable), N);
+
+    DepartureQueue pending(lt.base, lt.span);
+    for (int j = 0; j < N; j++) {
+        float t = take_leg(lt, N, j, start_time);
+        if (t < INF_TIME) pending.push(PendingLabel{t, 1u << j, j, -1});
+    }
+    std::vector<SettledLabel> settled;
+    StateSet settled_states;
+    // Settled sets by last checkpoint and checkpoint count: sets[pos * (N + 1) + count]
+    std::vector<std::vector<uint32_t>> sets((size_t)N * (N + 1));
+    COUNT(clock.lap(&counters.init_ms);)
+
+    int best_label = -1;
+    int best_count = 0;
+    float best_arrival = INF_TIME;
+    int64_t n_covered = 0;
+    bool finished = true;
+    int64_t pops = 0;
+    size_t peak_bytes = 0;
+    auto note_bytes = [&] {
+        size_t bytes = pending.bytes() +
+            settled.capacity() * sizeof(SettledLabel) + settled.size() * sizeof(uint32_t) +
+            settled_states.bytes();
+        peak_bytes = std::max(peak_bytes, bytes);
+    };
+    while (!pending.empty()) {
+        if ((++pops & 4095) == 0) {
+            note_bytes();
+            if (ws->should_stop()) {
+                finished = false;
+                break;
+            }
+        }
+        PendingLabel label = pending.pop();
+
+        int count = popcount((int)label.mask);
+        bool covered = settled_states.contains(label.mask, label.pos);
+        // A cover adds only skippable checkpoints outside label.mask
+        uint32_t sel = label.mask | ~skippable;
+        int max_count = count + popcount((int)(skippable & ~label.mask));
+        for (int c = count + 1; c <= max_count && !covered; c++) {
+            const std::vector<uint32_t>& list = sets[(size_t)label.pos * (N + 1) + c];
+            covered = kSupersetKernel(list.data(), list.size(), sel, label.mask);
+        }
+        if (covered) {
+            n_covered++;
+            continue;
+        }
+        COUNT(counters.reached[count]++;)
+        int index = (int)settled.size();
+        settled.push_back(SettledLabel{label.mask, label.pos, label.parent});
+        settled_states.insert(label.mask, label.pos);
+        sets[(size_t)label.pos * (N + 1) + count].push_back(label.mask);
+
+        if (label.depart <= depart_limit[label.pos]) {
+            float arrival = label.depart + finish_travel[label.pos];
+            if (count > best_count || (count == best_count && arrival < best_arrival)) {
+                bool more = count > best_count;
+                best_label = index;
+                best_count = count;
+                best_arrival = arrival;
+                if (more && ws->progress) ws->progress(SolveProgress{count, N, count});
+            }
+        }
+
+        float arrival;
+        int extra = extension_bound(tables, bounds, label.mask, label.pos, label.depart,
+                                    std::max(best_count - count, 0), &arrival);
+        bool worth = count + extra > best_count ||
+            (count + extra == best_count && arrival - BOUND_SLACK < best_arrival);
+        if (!worth) continue;
+        for (int j = 0; j < N; j++) {
+            if ((label.mask >> j) & 1) continue;
+            COUNT(counters.transitions++;)
+            float t = take_leg(lt, label.pos, j, label.depart);
+            if (t < INF_TIME) pending.push(PendingLabel{t, label.mask | 1u << j, j, index});
+        }
+    }
+    note_bytes();
+    COUNT(clock.lap(&counters.layers_ms);)
+    if (!finished) ws->stopped = true;
+
+    if (best_label >= 0) {
+        std::vector<int> route;
+        for (int k = best_label; k >= 0; k = settled[k].parent) route.push_back(settled[k].pos);
+        std::reverse(route.begin(), route.end());
+        result->count = best_count;
+        result->route = route;
+        result->finish_time = finish_time_at(tables.open_table, best_arrival);
+    }
+    COUNT(clock.lap(&counters.reconstruct_ms);)
+    float unused;
+    int from_start = extension_bound(tables, bounds, 0, N, start_time, 1, &unused);
+    result->count_bound = finished ? best_count : std::max(best_count, from_start);
+    if (ws->progress) ws->progress(SolveProgress{N, N, best_count});
+    LOGI("Label setting: %d checkpoints, finish=%.1f, %zu labels settled, %lld covered%s",
+         best_count, result->finish_time, settled.size(), (long long)n_covered,
+         finished ? "" : ", stopped");
+    COUNT(log_counters(counters, N);)
+    ws->record_pass((int64_t)settled.size(), peak_bytes, counters);
+}
+
+// Solves up to MAX_LANES inputs in one DP pass.
+static void solve_lanes(const SolverInput* inputs, int n_lanes, SolverResult* results,
+                        Workspace* ws) {
+    if (inputs[0].engine == ENGINE_BRANCH_BOUND) {
+        for (int lane = 0; lane < n_lanes; lane++) {
+            solve_branch_bound(&inputs[lane], &results[lane], ws);
+        }
+        return;
+    }
+    if (inputs[0].engine == ENGINE_LABEL_SETTING) {
+        for (int lane = 0; lane < n_lanes; lane++) {
+            solve_label_setting(&inputs[lane], &results[lane], ws);
+        }
+        return;
+    }
+    if (inputs[0].n_checkpoints > MAX_DENSE_CP) {
+        for (int lane = 0; lane < n_lanes; lane++) {
+            solve_meet(&inputs[lane], &results[lane], ws);
+        }
+        return;
+    }
+    DpTable& table = ws->table;
+    SolveCounters counters{};
+    if (!run_dp(inputs, n_lanes, &table, ws, &counters)) ws->stopped = true;
+
+    const int no_exclusions = 0;
+    for (int lane = 0; lane < n_lanes; lane++) {
+        best_routes(table, lane, &no_exclusions, 1, &results[lane], &counters);
+    }
+    if (table.seconds) {
+        // Rounding down never loses a state, so the counts are at least the
+        // float ones; they are exact once every route replays. Otherwise
+        // the pass is worth solving again in floats.
+        bool replayed = true;
+        for (int lane = 0; lane < n_lanes && replayed; lane++) {
+            if (results[lane].count == 0) continue;
+            float finish = replay_finish(table, lane, (float)inputs[lane].start_time,
+                                         results[lane].route);
+            replayed = finish < INF_TIME;
+            results[lane].finish_time = finish;
+        }
+        if (!replayed) {
+            LOGI("16-bit times found a route that misses a window, solving with floats");
+            ws->record_pass(table, counters);
+            std::vector<SolverInput> exact(inputs, inputs + n_lanes);
+            for (SolverInput& input : exact) input.time_mode = TIME_FLOAT;
+            solve_lanes(exact.data(), n_lanes, results, ws);
+            return;
+        }
+    }
+    for (int lane = 0; lane < n_lanes; lane++) {
+        if (results[lane].count == 0) {
+            LOGI("No feasible route found at speed %.2f", inputs[lane].speed);
+        } else {
+            LOGI("Solved at speed %.2f: %d checkpoints, finish=%.1f",
+                 inputs[lane].speed, results[lane].count, results[lane].finish_time);
+        }
+    }
+    COUNT(log_counters(counters, table.n_checkpoints);)
+    ws->record_pass(table, counters);
+
+    if (inputs[0].time_mode != TIME_VERIFY || ws->stopped) return;
+
+    // Verification: solve again with 16-bit times and compare. Counts must
+    // agree, but rounding can break near-ties the other way, so a
+    // difference here is logged rather than treated as a failure.
+    std::vector<SolverInput> quantised(inputs, inputs + n_lanes);
+    for (SolverInput& input : quantised) input.time_mode = TIME_SECONDS;
+    std::vector<SolverResult> check(n_lanes);
+    solve_lanes(quantised.data(), n_lanes, check.data(), ws);
+    for (int lane = 0; lane < n_lanes; lane++) {
+        const SolverResult& expected = results[lane];
+        if (check[lane].count != expected.count || check[lane].route != expected.route) {
+            LOGE("16-bit times differ at speed %.2f: %d checkpoints (finish %.2f) vs %d (finish %.2f)",
+                 inputs[lane].speed, check[lane].count, check[lane].finish_time,
+                 expected.count, expected.finish_time);
+        } else {
+            LOGI("16-bit times agree at speed %.2f, finish %.3f vs %.3f",
+                 inputs[lane].speed, check[lane].finish_time, expected.finish_time);
+        }
+    }
+}
+
+// Solves any number of lanes, as many per pass as MAX_LANES and the state
+// budget allow.
+static void solve_batch(const SolverInput* inputs, int n_inputs, SolverResult* results,
+                        Workspace* ws) {
+    size_t lane_states = ((size_t)1 << inputs[0].n_checkpoints) * (size_t)inputs[0].n_checkpoints;
+    int per_pass = (int)std::max<size_t>(1, std::min<size_t>(MAX_LANES, BATCH_STATES / lane_states));
+    for (int first = 0; first < n_inputs; first += per_pass) {
+        solve_lanes(&inputs[first], std::min(per_pass, n_inputs - first), &results[first], ws);
+    }
+}
+
+// Whether route can be walked from Start at input's speed and still reach
+// Finish in time, under exactly the rules the DP applies.
+static bool route_feasible(const SolverInput* input, const OpenTable& table,
+                           const std::vector<int>& route) {
+    std::vector<float> depart_limit;
+    build_depart_limits(input, table, &depart_limit);
+    LegTable legs;
+    build_leg_table(input, table, depart_limit, &legs);
+
+    int from = input->start_idx();
+    float depart = (float)input->start_time;
+    for (int j : route) {
+        depart = take_leg(legs, from, j, depart);
+        if (depart >= INF_TIME) return false;
+        from = j;
+    }
+    return depart <= depart_limit[from];
+}
+
+// Lowest speed in [lo, hi] at which route is feasible, given that it is
+// feasible at hi. Travel times never grow with speed and the DP rules are
+// monotone in them, so feasibility is monotone in speed and a bisection
+// over the float bit patterns (ordered like the values for positive
+// floats) finds the exact threshold.
+static float critical_speed(SolverInput* input, const OpenTable& table,
+                            const std::vector<int>& route, float lo, float hi) {
+    set_speed(input, lo);
+    if (route_feasible(input, table, route)) return lo;
+    uint32_t infeasible, feasible;
+    memcpy(&infeasible, &lo, sizeof lo);
+    memcpy(&feasible, &hi, sizeof hi);
+    while (feasible - infeasible > 1) {
+        uint32_t mid_bits = infeasible + (feasible - infeasible) / 2;
+        float mid;
+        memcpy(&mid, &mid_bits, sizeof mid);
+        set_speed(input, mid);
+        if (route_feasible(input, table, route)) feasible = mid_bits;
+        else infeasible = mid_bits;
+    }
+    float result;
+    memcpy(&result, &feasible, sizeof result);
+    return result;
+}
+
+// The steps of count(speed) over [min_speed, max_speed], highest count
+// first, stopping below min_count. count(speed) is non-decreasing, so each
+// step is found by narrowing a bracket (lo, hi] in float bits, where lo
+// reaches fewer checkpoints and hi is the critical speed of a route that
+// reaches the step's count. Probes alternate between just below hi, which
+// proves hi is the breakpoint unless another route still works there, and
+// the midpoint of the bracket. Any successful probe moves hi down to the
+// critical speed of its route rather than to the probe, so the search
+// follows routes where that is faster and bisects where it is not. The
+// failing probe nearest the breakpoint seeds the next step down. A step
+// at min_speed means "min_speed or below". If the workspace stops a
+// solve, the steps found before it are kept and the search ends.
+static void solve_frontier(SolverInput* input, float min_speed, float max_speed, int min_count,
+                           std::vector<SpeedStep>* steps, Workspace* ws) {
+    OpenTable table;
+    build_open_table(input, &table);
+    steps->clear();
+
+    int n_solves = 0;
+    // False, with a note, if the solve stopped early and cannot be used
+    auto solve_at = [&](float speed, SolverResult* result) {
+        set_speed(input, speed);
+        solve_lanes(input, 1, result, ws);
+        n_solves++;
+        if (ws->stopped) LOGI("Speed frontier stopped after %zu steps", steps->size());
+        return !ws->stopped;
+    };
+
+    // Highest-speed solve of the step being searched, count below its top
+    float seed_speed = max_speed;
+    SolverResult seed;
+    if (!solve_at(seed_speed, &seed)) return;
+
+    while (seed.count > 0 && seed.count >= min_count) {
+        int count = seed.count;
+        float hi = critical_speed(input, table, seed.route, min_speed, seed_speed);
+        bool have_hi = hi == seed_speed;
+        SolverResult at_hi;
+        if (have_hi) at_hi = seed;
+        uint32_t lo_bits = float_bits(min_speed) - 1; // nothing known to fail yet
+        SolverResult at_lo;
+        at_lo.count = 0;
+        at_lo.finish_time = 0.0f;
+
+        bool probe_below_hi = true;
+        while (hi > min_speed && float_bits(hi) - lo_bits > 1) {
+            uint32_t hi_bits = float_bits(hi);
+            float probe = probe_below_hi ? bits_float(hi_bits - 1)
+                                         : bits_float(lo_bits + (hi_bits - lo_bits) / 2);
+            SolverResult at_probe;
+            if (!solve_at(probe, &at_probe)) return;
+            if (at_probe.count >= count) {
+                hi = critical_speed(input, table, at_probe.route, min_speed, probe);
+                have_hi = hi == probe;
+                if (have_hi) at_hi = at_probe;
+                probe_below_hi = !probe_below_hi;
+            } else {
+                lo_bits = float_bits(probe);
+                at_lo = at_probe;
+                probe_below_hi = true;
+            }
+        }
+
+        if (!have_hi && !solve_at(hi, &at_hi)) return;
+        steps->push_back({hi, at_hi});
+        if (hi <= min_speed) break;
+        seed_speed = bits_float(lo_bits);
+        seed = at_lo;
+    }
+
+    LOGI("Speed frontier: %zu steps from %d solves", steps->size(), n_solves);
+}
+
+// ── Sessions ────────────────────────────────────────────────────────
+//
+// A session holds a problem over every checkpoint with raw leg geometry,
+// so solves that only change speed, dwell or exclusions are set up
+// natively from it. Dropping checkpoints keeps the order of the rest, and
+// travel_minutes() matches the Kotlin travel times bit for bit, so a
+// session solve returns exactly what a solve of the reduced problem built
+// in Kotlin would, with routes in session indices.
+struct Session {
+    SolverInput full;   // travel_time unused; distance and height_gain set
+};
+
+// The input for one solve: the session's checkpoints outside excluded
+// (bit k = checkpoint k), at speed and dwell. index[k] is the session
+// checkpoint behind checkpoint k of the reduced input.
+static void session_input(const Session& session, float speed, int dwell, int excluded,
+                          SolverInput* input, std::vector<int>* index) {
+    const SolverInput& full = session.full;
+    index->clear();
+    for (int k = 0; k < full.n_checkpoints; k++) {
+        if (!((excluded >> k) & 1)) index->push_back(k);
+    }
+    int N = (int)index->size();
+
+    // Start and Finish stay at the end of the node list
+    std::vector<int> nodes(*index);
+    nodes.push_back(full.start_idx());
+    nodes.push_back(full.finish_idx());
+
+    *input = SolverInput();
+    input->n_checkpoints = N;
+    input->n_slots = full.n_slots;
+    input->finish_open = full.finish_open;
+    input->slot_starts = full.slot_starts;
+    input->dwell = dwell;
+    input->naismith = full.naismith;
+    input->start_time = full.start_time;
+    input->end_time = full.end_time;
+    input->n_threads = full.n_threads;
+
+    input->open_at.resize((size_t)N * full.n_slots);
+    for (int k = 0; k < N; k++) {
+        std::copy_n(&full.open_at[(size_t)(*index)[k] * full.n_slots], full.n_slots,
+                    &input->open_at[(size_t)k * full.n_slots]);
+    }
+
+    int nNodes = N + 2;
+    input->distance.resize((size_t)nNodes * nNodes);
+    input->height_gain.resize((size_t)nNodes * nNodes);
+    for (int i = 0; i < nNodes; i++) {
+        for (int j = 0; j < nNodes; j++) {
+            size_t from = (size_t)nodes[i] * full.n_nodes() + nodes[j];
+            input->distance[(size_t)i * nNodes + j] = full.distance[from];
+            input->height_gain[(size_t)i * nNodes + j] = full.height_gain[from];
+        }
+    }
+    set_speed(input, speed);
+}
+
+// Rewrites a route of a session_input() solve in session indices.
+static void to_session_route(const std::vector<int>& index, SolverResult* result) {
+    for (int& cp : result->route) cp = index[cp];
+}
+
+// Solves a session at each of speeds without the excluded checkpoints,
+// batching the speeds into shared DP passes. Routes are in session indices.
+// With timeline set, a single speed's stops are also written there, in
+// session node indices.
+void session_solve(const Session& session, const float* speeds, int n_speeds, int dwell,
+                   int excluded, int time_mode, int engine, Workspace* ws,
+                   SolverResult* results, std::vector<Stop>* timeline) {
+    SolverInput input;
+    std::vector<int> index;
+    session_input(session, speeds[0], dwell, excluded, &input, &index);
+    input.time_mode = time_mode;
+    input.engine = engine;
+    ws->begin_call();
+    if (timeline) timeline->clear();
+    if (input.n_checkpoints == 0) {
+        for (int k = 0; k < n_speeds; k++) results[k] = SolverResult{0, {}, 0.0f};
+        return;
+    }
+
+    std::vector<SolverInput> inputs(n_speeds, input);
+    for (int k = 1; k < n_speeds; k++) set_speed(&inputs[k], speeds[k]);
+    solve_batch(inputs.data(), n_speeds, results, ws);
+
+    // The workspace still holds the last pass, which for one speed is
+    // this solve's table
+    if (timeline && n_speeds == 1) {
+        route_timeline(ws->table, 0, (float)input.start_time, results[0].route, timeline);
+        const SolverInput& full = session.full;
+        for (Stop& stop : *timeline) {
+            stop.node = stop.node < input.n_checkpoints ? index[stop.node]
+                      : stop.node == input.start_idx() ? full.start_idx() : full.finish_idx();
+        }
+    }
+    ws->trim();
+    for (int k = 0; k < n_speeds; k++) to_session_route(index, &results[k]);
+}
+
+void session_frontier(const Session& session, float min_speed, float max_speed, int min_count,
+                      int dwell, int excluded, Workspace* ws, std::vector<SpeedStep>* steps) {
+    SolverInput input;
+    std::vector<int> index;
+    session_input(session, max_speed, dwell, excluded, &input, &index);
+    ws->begin_call();
+    steps->clear();
+    if (input.n_checkpoints == 0) return;
+
+    solve_frontier(&input, min_speed, max_speed, min_count, steps, ws);
+    ws->trim();
+    for (SpeedStep& step : *steps) to_session_route(index, &step.result);
+}
+
+Session* create_session(SolverInput full) {
+    Session* session = new Session();
+    session->full = std::move(full);
+    return session;
+}
+
+void release_session(Session* session) {
+    delete session;
+}
+
+const SolverInput& session_problem(const Session& session) {
+    return session.full;
+}
+
+// ── Workspaces and exclusion analysis ───────────────────────────────
+
+Workspace* create_workspace() {
+    return new Workspace();
+}
+
+void release_workspace(Workspace* ws) {
+    delete ws;
+}
+
+const SolveStats& workspace_stats(const Workspace& ws) {
+    return ws.stats;
+}
+
+void reset_workspace_stats(Workspace* ws) {
+    ws->stats = SolveStats{};
+}
+
+void set_solve_budget(Workspace* ws, double budget_ms) {
+    ws->budget_ms = budget_ms;
+}
+
+void set_solve_progress(Workspace* ws, ProgressFn progress) {
+    ws->progress = std::move(progress);
+}
+
+void cancel_solve(Workspace* ws) {
+    ws->cancelled.store(true, std::memory_order_relaxed);
+}
+
+void clear_cancel(Workspace* ws) {
+    ws->cancelled.store(false, std::memory_order_relaxed);
+}
+
+bool solve_stopped(const Workspace& ws) {
+    return ws.stopped;
+}
+
+// The table is the analysis's own; the workspace lends its threads and
+// stop conditions. It keeps floats: a seconds table's routes only hold
+// once replayed, and a query has no float pass to fall back on.
+DpTable* session_exclusion_analysis(const Session& session, float speed, int dwell,
+                                    Workspace* ws) {
+    SolverInput input;
+    std::vector<int> index;
+    session_input(session, speed, dwell, 0, &input, &index);
+    if (input.n_checkpoints > MAX_DENSE_CP) {
+        LOGE("Exclusion analysis needs at most %d checkpoints, got %d",
+             MAX_DENSE_CP, input.n_checkpoints);
+        return nullptr;
+    }
+
+    DpTable* table = new DpTable();
+    SolveCounters counters{};
+    ws->begin_call();
+    if (!run_dp(&input, 1, table, ws, &counters)) ws->stopped = true;
+    COUNT(log_counters(counters, table->n_checkpoints);)
+    ws->record_pass(*table, counters);
+    return table;
+}
+
+void query_exclusions(const DpTable& table, const int* excluded, int n_queries,
+                      SolverResult* results) {
+    best_routes(table, 0, excluded, n_queries, results);
+}
+
+void release_exclusion_analysis(DpTable* table) {
+    delete table;
+}
+
+bool solver_info_logging = false;
 
-    return output;
+void set_info_logging(bool enabled) {
+    solver_info_logging = enabled;
 }
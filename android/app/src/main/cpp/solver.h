@@ -0,0 +1,189 @@
+#pragma once
+
+// Route solver core: a bitmask DP over visited checkpoint sets with
+// opening windows. It has no JNI or Android dependency; solver_jni.cpp
+// adapts it for the app and dovetrek_solve.cpp runs it from the command
+// line.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Upper bound on intermediate checkpoints, kept in step with
+// NativeSolver.MAX_CHECKPOINTS. The binomial table and kernel strides are
+// sized by it, and visited sets must fit in 32 bits.
+static const int MAX_CP = 32;
+
+// Largest problem solved by filling the whole mask lattice. Bigger ones
+// are solved by a meet-in-the-middle search from Start and Finish, which
+// gives the same count and finish time (see solver.cpp).
+static const int MAX_DENSE_CP = 24;
+
+// How the DP stores departure times. TIME_SECONDS keeps them as uint16
+// seconds after the first slot, rounded down, which halves the table. Its
+// routes are replayed in floats, and a pass with one that misses a window
+// is solved again in floats, so the count always matches TIME_FLOAT; a
+// near-tie may still pick a route that finishes a little later. Exclusion
+// analyses keep floats. TIME_VERIFY solves both ways, logs any difference
+// and returns the float result.
+enum TimeMode { TIME_FLOAT = 0, TIME_SECONDS = 1, TIME_VERIFY = 2 };
+
+// Which search a solve runs. ENGINE_AUTO fills the DP table up to
+// MAX_DENSE_CP checkpoints and meets in the middle above that.
+// ENGINE_BRANCH_BOUND searches routes depth first with pruning, needs
+// almost no memory and, when stopped early, says through count_bound how
+// far from proven its route is. ENGINE_LABEL_SETTING settles route
+// prefixes in order of departure on one thread, dropping any that another
+// prefix covers. Finished solves of every engine are optimal.
+enum Engine { ENGINE_AUTO = 0, ENGINE_BRANCH_BOUND = 1, ENGINE_LABEL_SETTING = 2 };
+
+// Node layout: intermediates are 0..N-1, then Start (N) and Finish (N+1).
+struct SolverInput {
+    int n_checkpoints;                  // N
+    int n_slots;                        // 15
+    std::vector<float> travel_time;     // (N+2) x (N+2), row-major, from set_speed()
+    std::vector<float> distance;        // (N+2) x (N+2) km, NaN = no leg
+    std::vector<float> height_gain;     // (N+2) x (N+2) metres
+    std::vector<uint8_t> open_at;       // N x n_slots, intermediate CP openings
+    std::vector<uint8_t> finish_open;   // n_slots, Finish openings
+    std::vector<int> slot_starts;       // n_slots, slot start times in minutes
+    float speed;
+    int dwell;                  // 7
+    float naismith;             // 10.0
+    int start_time;             // 600
+    int end_time;               // 1020
+    int n_threads;              // DP worker threads, 0 = one per core
+    int time_mode = TIME_FLOAT;
+    int engine = ENGINE_AUTO;
+
+    int n_nodes() const { return n_checkpoints + 2; }
+    int start_idx() const { return n_checkpoints; }
+    int finish_idx() const { return n_checkpoints + 1; }
+    float tt(int from, int to) const { return travel_time[from * n_nodes() + to]; }
+    bool is_open(int cp, int slot) const { return open_at[cp * n_slots + slot] != 0; }
+};
+
+struct SolverResult {
+    int count;                  // checkpoints visited
+    std::vector<int> route;     // CP indices in order
+    float finish_time;          // in minutes from midnight
+    int count_bound = 0;        // no route visits more; count unless stopped early
+};
+
+// One step of count(speed): the lowest speed at which `result.count`
+// checkpoints can be visited, and the solve at exactly that speed.
+struct SpeedStep {
+    float speed;
+    SolverResult result;
+};
+
+// One stop of a route's timeline, in minutes from midnight. At Start both
+// times are start_time; at Finish the departure is the check-in time.
+struct Stop {
+    int node;
+    float arrival;
+    float depart;
+};
+
+// Hot-path counters, compiled in by building with SOLVER_COUNTERS defined
+// (the CMake option of that name) and all zero otherwise. Layers are
+// indexed by popcount; a rejected leg is counted under the first check it
+// fails, in the order listed.
+struct SolveCounters {
+    int64_t reached[MAX_CP + 1];    // (mask, position, speed) states reached
+    int64_t live[MAX_CP + 1];       // (mask, speed) pairs on the frontier
+    int64_t transitions;            // legs tried from reached states
+    int64_t past_end_time;          // arrive after end_time, or no such leg
+    int64_t window_closed;          // target never opens again
+    int64_t finish_unreachable;     // cannot leave the target in time for Finish
+    double init_ms;                 // tables, allocation and Start legs
+    double layers_ms;               // the popcount layers
+    double best_scan_ms;            // finding each best final state
+    double reconstruct_ms;          // walking routes back
+};
+
+// Work done through one workspace since it was created or its stats were
+// last reset.
+struct SolveStats {
+    int64_t dp_passes;          // runs over the mask lattice
+    int64_t states;             // (mask, position, speed) states filled
+    size_t peak_table_bytes;    // largest DP table held
+    SolveCounters counters;
+};
+
+// ── Workspaces ──────────────────────────────────────────────────────
+//
+// DP memory and worker threads kept between solves. A workspace serves
+// one solve at a time.
+struct Workspace;
+
+Workspace* create_workspace();
+void release_workspace(Workspace* ws);
+const SolveStats& workspace_stats(const Workspace& ws);
+void reset_workspace_stats(Workspace* ws);
+
+// Progress of a DP pass, reported on the calling thread after each
+// popcount layer. Branch and bound reports each first checkpoint it has
+// searched from as a layer, label setting each better count it finds.
+struct SolveProgress {
+    int layer;          // layers finished
+    int n_layers;       // N
+    int best_count;     // most checkpoints of any finishing route so far
+};
+
+typedef std::function<void(const SolveProgress&)> ProgressFn;
+
+// Early stopping. A solve, frontier or analysis on the workspace stops
+// once cancel_solve() has been called, from any thread, or once budget_ms
+// has passed since the call began; workers check between chunks of masks.
+// A stopped solve returns the best routes among the states it reached,
+// which are all feasible; a stopped frontier returns the steps it had
+// finished. solve_stopped() tells whether the last call stopped early.
+// Cancellation lasts until clear_cancel().
+void set_solve_budget(Workspace* ws, double budget_ms);     // 0 = no limit
+void set_solve_progress(Workspace* ws, ProgressFn progress);
+void cancel_solve(Workspace* ws);
+void clear_cancel(Workspace* ws);
+bool solve_stopped(const Workspace& ws);
+
+// ── Sessions ────────────────────────────────────────────────────────
+//
+// A problem over every checkpoint with raw leg geometry (distance and
+// height_gain set, travel_time unused), from which each solve derives its
+// own input. Exclusions are masks over the session's checkpoints (bit k =
+// checkpoint k); routes, timelines and steps come back in session indices.
+struct Session;
+
+Session* create_session(SolverInput full);
+void release_session(Session* session);
+const SolverInput& session_problem(const Session& session);
+
+// Best route at each of speeds, batched into shared DP passes. With
+// timeline set and a single speed, that route's stops are written there.
+void session_solve(const Session& session, const float* speeds, int n_speeds, int dwell,
+                   int excluded, int time_mode, int engine, Workspace* ws,
+                   SolverResult* results, std::vector<Stop>* timeline = nullptr);
+
+// Steps of count(speed) over [min_speed, max_speed], highest count first,
+// stopping below min_count checkpoints.
+void session_frontier(const Session& session, float min_speed, float max_speed, int min_count,
+                      int dwell, int excluded, Workspace* ws, std::vector<SpeedStep>* steps);
+
+// ── Exclusion analysis ──────────────────────────────────────────────
+//
+// One full solve whose DP table is kept to answer "best route without
+// these checkpoints" for any exclusion mask. Needs the whole lattice, so
+// returns null past MAX_DENSE_CP checkpoints. The table always stores
+// floats.
+struct DpTable;
+
+DpTable* session_exclusion_analysis(const Session& session, float speed, int dwell,
+                                    Workspace* ws);
+void query_exclusions(const DpTable& table, const int* excluded, int n_queries,
+                      SolverResult* results);
+void release_exclusion_analysis(DpTable* table);
+
+// Info messages go to logcat on Android and are off elsewhere unless
+// enabled here; errors are always logged.
+void set_info_logging(bool enabled);
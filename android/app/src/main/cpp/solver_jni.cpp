@@ -0,0 +1,384 @@
+// JNI adapter between NativeSolver.kt and the solver core: copies arrays
+// in, calls the core and packs its results for Kotlin.
+
+#include "solver.h"
+#include "solver_log.h"
+
+#include <jni.h>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Copies the opening schedule shared by every JNI entry point.
+static void read_schedule(JNIEnv* env, jbooleanArray openingsFlat, jbooleanArray finishOpenings,
+                          jintArray slotStarts, SolverInput* input) {
+    int nCheckpoints = input->n_checkpoints;
+    int nSlots = input->n_slots;
+
+    // Copy openings (N x nSlots flattened)
+    input->open_at.resize(nCheckpoints * nSlots);
+    env->GetBooleanArrayRegion(openingsFlat, 0, nCheckpoints * nSlots, input->open_at.data());
+
+    // Copy finish openings
+    input->finish_open.resize(nSlots);
+    env->GetBooleanArrayRegion(finishOpenings, 0, nSlots, input->finish_open.data());
+
+    // Copy slot starts
+    input->slot_starts.resize(nSlots);
+    env->GetIntArrayRegion(slotStarts, 0, nSlots, input->slot_starts.data());
+}
+
+// Appends one result record:
+// [count, count_bound, route_length, finish_time_bits, route[0], route[1], ...]
+static void append_result(const SolverResult& result, std::vector<jint>* out) {
+    int routeLength = (int)result.route.size();
+    jint finishBits;
+    memcpy(&finishBits, &result.finish_time, sizeof finishBits);
+    out->push_back(result.count);
+    out->push_back(result.count_bound);
+    out->push_back(routeLength);
+    out->push_back(finishBits);
+    for (int i = 0; i < routeLength; i++) {
+        out->push_back(result.route[i]);
+    }
+}
+
+static jintArray to_int_array(JNIEnv* env, const std::vector<jint>& buf) {
+    jintArray output = env->NewIntArray((jsize)buf.size());
+    env->SetIntArrayRegion(output, 0, (jsize)buf.size(), buf.data());
+    return output;
+}
+
+// Forwards the workspace's layer progress to NativeSolver.onSolveProgress
+// for the life of one entry point; the core reports on the calling
+// thread. A callback that throws cancels the solve, and Kotlin sees the
+// exception once the entry point returns; until then no other JNI call is
+// allowed, so entry points check for it before building their output.
+class ScopedProgress {
+public:
+    ScopedProgress(JNIEnv* env, jobject thiz, Workspace* ws) : ws_(ws) {
+        jmethodID method = env->GetMethodID(env->GetObjectClass(thiz), "onSolveProgress", "(III)V");
+        set_solve_progress(ws, [env, thiz, method, ws](const SolveProgress& p) {
+            if (env->ExceptionCheck()) return;
+            env->CallVoidMethod(thiz, method, p.layer, p.n_layers, p.best_count);
+            if (env->ExceptionCheck()) cancel_solve(ws);
+        });
+    }
+
+    ~ScopedProgress() { set_solve_progress(ws_, nullptr); }
+
+private:
+    Workspace* ws_;
+};
+
+// A Workspace for the solve entry points below. The handle must be passed
+// to releaseWorkspaceNative.
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_createWorkspaceNative(
+    JNIEnv* /* env */, jobject /* thiz */)
+{
+    return (jlong)(intptr_t)create_workspace();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_releaseWorkspaceNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong workspace)
+{
+    release_workspace((Workspace*)(intptr_t)workspace);
+}
+
+// Sets the stop conditions for the next calls on the workspace: a
+// wall-clock budget per call (0 for none) and whether they are cancelled
+// from the start.
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_prepareSolveNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong workspace, jlong budgetMs, jboolean cancelled)
+{
+    Workspace* ws = (Workspace*)(intptr_t)workspace;
+    clear_cancel(ws);
+    if (cancelled) cancel_solve(ws);
+    set_solve_budget(ws, (double)budgetMs);
+}
+
+// Stops the workspace's current call; safe from any thread while the
+// workspace is alive.
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_cancelSolveNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong workspace)
+{
+    cancel_solve((Workspace*)(intptr_t)workspace);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_solveStoppedNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong workspace)
+{
+    return solve_stopped(*(const Workspace*)(intptr_t)workspace);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_resetWorkspaceStatsNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong workspace)
+{
+    reset_workspace_stats((Workspace*)(intptr_t)workspace);
+}
+
+// Stats of the workspace's solves since the last reset, as
+// [dp_passes, states, peak_table_bytes, counted, transitions,
+//  past_end_time, window_closed, finish_unreachable, init_us, layers_us,
+//  best_scan_us, reconstruct_us, reached by layer (MAX_CP + 1),
+//  live by layer (MAX_CP + 1)]. counted is 1 when the library was built
+// with SOLVER_COUNTERS; otherwise the counters are all zero.
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_workspaceStatsNative(
+    JNIEnv* env, jobject /* thiz */,
+    jlong workspace)
+{
+    const SolveStats& stats = workspace_stats(*(const Workspace*)(intptr_t)workspace);
+    const SolveCounters& c = stats.counters;
+#ifdef SOLVER_COUNTERS
+    const jlong counted = 1;
+#else
+    const jlong counted = 0;
+#endif
+    std::vector<jlong> outBuf = {
+        stats.dp_passes, stats.states, (jlong)stats.peak_table_bytes, counted,
+        c.transitions, c.past_end_time, c.window_closed, c.finish_unreachable,
+        (jlong)(c.init_ms * 1000.0), (jlong)(c.layers_ms * 1000.0),
+        (jlong)(c.best_scan_ms * 1000.0), (jlong)(c.reconstruct_ms * 1000.0),
+    };
+    outBuf.insert(outBuf.end(), c.reached, c.reached + MAX_CP + 1);
+    outBuf.insert(outBuf.end(), c.live, c.live + MAX_CP + 1);
+
+    jlongArray output = env->NewLongArray((jsize)outBuf.size());
+    env->SetLongArrayRegion(output, 0, (jsize)outBuf.size(), outBuf.data());
+    return output;
+}
+
+// Holds a problem over all nCheckpoints for the session entry points
+// below. distances and heightGains are (N+2) x (N+2), NaN for legs that do
+// not exist; travel times are derived natively at each speed. The handle
+// must be passed to releaseSessionNative.
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_createSessionNative(
+    JNIEnv* env, jobject /* thiz */,
+    jfloatArray distances,
+    jfloatArray heightGains,
+    jbooleanArray openingsFlat,
+    jbooleanArray finishOpenings,
+    jintArray slotStarts,
+    jfloat naismith,
+    jint startTime, jint endTime,
+    jint nCheckpoints, jint nSlots,
+    jint nThreads)
+{
+    int nNodes = nCheckpoints + 2;
+    if (nCheckpoints < 1 || nCheckpoints > MAX_CP || nSlots < 1 ||
+        env->GetArrayLength(distances) < nNodes * nNodes ||
+        env->GetArrayLength(heightGains) < nNodes * nNodes ||
+        env->GetArrayLength(openingsFlat) < nCheckpoints * nSlots ||
+        env->GetArrayLength(finishOpenings) < nSlots ||
+        env->GetArrayLength(slotStarts) < nSlots) {
+        LOGE("Invalid session input: N=%d (max %d), slots=%d", nCheckpoints, MAX_CP, nSlots);
+        env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"),
+                      "Invalid solver input");
+        return 0;
+    }
+
+    SolverInput input;
+    input.n_checkpoints = nCheckpoints;
+    input.n_slots = nSlots;
+    input.naismith = naismith;
+    input.start_time = startTime;
+    input.end_time = endTime;
+    input.n_threads = nThreads;
+    read_schedule(env, openingsFlat, finishOpenings, slotStarts, &input);
+
+    input.distance.resize(nNodes * nNodes);
+    env->GetFloatArrayRegion(distances, 0, nNodes * nNodes, input.distance.data());
+    input.height_gain.resize(nNodes * nNodes);
+    env->GetFloatArrayRegion(heightGains, 0, nNodes * nNodes, input.height_gain.data());
+    return (jlong)(intptr_t)create_session(std::move(input));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_releaseSessionNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong session)
+{
+    release_session((Session*)(intptr_t)session);
+}
+
+// Layout of the packed route written by sessionSolveIntoNative, in native
+// byte order with 4-byte fields: count, stop count, finish time, count
+// bound, then node, arrival and departure for each stop from Start to
+// Finish. Nodes are session indices; times are floats. Mirrors
+// NativeSolver.PackedRoute.
+static const int PACKED_HEADER_FIELDS = 4;
+static const int PACKED_STOP_FIELDS = 3;
+
+// Best route at one speed and dwell avoiding excludedMask, searched by
+// engine (Engine in solver.h) and written into the direct buffer out.
+// Nothing is allocated on the Java heap and no array crosses JNI.
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_sessionSolveIntoNative(
+    JNIEnv* env, jobject thiz,
+    jlong workspace, jlong session,
+    jfloat speed, jint dwell, jint excludedMask,
+    jint timeMode, jint engine, jobject out)
+{
+    const Session& s = *(const Session*)(intptr_t)session;
+    size_t needed = (size_t)(PACKED_HEADER_FIELDS + PACKED_STOP_FIELDS * session_problem(s).n_nodes()) * 4;
+    uint8_t* dst = (uint8_t*)env->GetDirectBufferAddress(out);
+    if (!dst || env->GetDirectBufferCapacity(out) < (jlong)needed) {
+        LOGE("Result buffer must be direct and hold %zu bytes", needed);
+        env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"),
+                      "Result buffer too small");
+        return;
+    }
+
+    Workspace* ws = (Workspace*)(intptr_t)workspace;
+    ScopedProgress progress(env, thiz, ws);
+    SolverResult result;
+    std::vector<Stop> timeline;
+    session_solve(s, &speed, 1, dwell, excludedMask, timeMode, engine, ws, &result, &timeline);
+    if (env->ExceptionCheck()) return;
+
+    int32_t header[PACKED_HEADER_FIELDS] = {result.count, (int32_t)timeline.size(), 0,
+                                            result.count_bound};
+    memcpy(&header[2], &result.finish_time, 4);
+    memcpy(dst, header, sizeof header);
+    dst += sizeof header;
+    for (const Stop& stop : timeline) {
+        int32_t fields[PACKED_STOP_FIELDS] = {stop.node, 0, 0};
+        memcpy(&fields[1], &stop.arrival, 4);
+        memcpy(&fields[2], &stop.depart, 4);
+        memcpy(dst, fields, sizeof fields);
+        dst += sizeof fields;
+    }
+}
+
+// Best route at each of speeds and dwell avoiding excludedMask, one result
+// record per speed in session indices.
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_sessionSolveSpeedsNative(
+    JNIEnv* env, jobject thiz,
+    jlong workspace, jlong session,
+    jfloatArray speeds, jint dwell, jint excludedMask,
+    jint timeMode, jint engine)
+{
+    int nSpeeds = speeds ? env->GetArrayLength(speeds) : 0;
+    if (nSpeeds < 1) {
+        LOGE("Invalid solver input: no speeds");
+        env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"),
+                      "Invalid solver input");
+        return nullptr;
+    }
+    std::vector<float> speedBuf(nSpeeds);
+    env->GetFloatArrayRegion(speeds, 0, nSpeeds, speedBuf.data());
+
+    Workspace* ws = (Workspace*)(intptr_t)workspace;
+    ScopedProgress progress(env, thiz, ws);
+    std::vector<SolverResult> results(nSpeeds);
+    session_solve(*(const Session*)(intptr_t)session, speedBuf.data(), nSpeeds, dwell,
+                  excludedMask, timeMode, engine, ws, results.data());
+    if (env->ExceptionCheck()) return nullptr;
+
+    std::vector<jint> outBuf;
+    for (const SolverResult& result : results) {
+        append_result(result, &outBuf);
+    }
+    return to_int_array(env, outBuf);
+}
+
+// Steps of count(speed) between minSpeed and maxSpeed, down to minCount
+// checkpoints, with excludedMask dropped.
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_sessionSpeedFrontierNative(
+    JNIEnv* env, jobject thiz,
+    jlong workspace, jlong session,
+    jfloat minSpeed, jfloat maxSpeed, jint minCount,
+    jint dwell, jint excludedMask)
+{
+    if (!(minSpeed > 0.0f) || !(maxSpeed >= minSpeed)) {
+        LOGE("Invalid frontier speeds %.2f..%.2f", minSpeed, maxSpeed);
+        env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"),
+                      "Invalid solver input");
+        return nullptr;
+    }
+
+    Workspace* ws = (Workspace*)(intptr_t)workspace;
+    ScopedProgress progress(env, thiz, ws);
+    std::vector<SpeedStep> steps;
+    session_frontier(*(const Session*)(intptr_t)session, minSpeed, maxSpeed, minCount, dwell,
+                     excludedMask, ws, &steps);
+    if (env->ExceptionCheck()) return nullptr;
+
+    // Return as int array: [n_steps, then per step speed_bits followed by a result record]
+    std::vector<jint> outBuf;
+    outBuf.push_back((jint)steps.size());
+    for (const SpeedStep& step : steps) {
+        jint speedBits;
+        memcpy(&speedBits, &step.speed, sizeof speedBits);
+        outBuf.push_back(speedBits);
+        append_result(step.result, &outBuf);
+    }
+    return to_int_array(env, outBuf);
+}
+
+// Runs the full DP of a session once and keeps its table for
+// queryExclusionsNative. The returned handle must be passed to
+// releaseExclusionAnalysisNative.
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_sessionExclusionAnalysisNative(
+    JNIEnv* env, jobject thiz,
+    jlong workspace, jlong session,
+    jfloat speed, jint dwell)
+{
+    Workspace* ws = (Workspace*)(intptr_t)workspace;
+    ScopedProgress progress(env, thiz, ws);
+    DpTable* table = session_exclusion_analysis(*(const Session*)(intptr_t)session, speed, dwell,
+                                                ws);
+    // Kotlin never sees the handle if the progress callback threw
+    if (env->ExceptionCheck()) {
+        release_exclusion_analysis(table);
+        return 0;
+    }
+    return (jlong)(intptr_t)table;
+}
+
+// Best route avoiding each of excludedMasks (bit k = checkpoint k), one
+// result record per mask, with route indices in the full problem.
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_queryExclusionsNative(
+    JNIEnv* env, jobject /* thiz */,
+    jlong handle,
+    jintArray excludedMasks)
+{
+    const DpTable* table = (const DpTable*)(intptr_t)handle;
+    int nQueries = env->GetArrayLength(excludedMasks);
+    std::vector<jint> masks(nQueries);
+    env->GetIntArrayRegion(excludedMasks, 0, nQueries, masks.data());
+
+    std::vector<SolverResult> results(nQueries);
+    query_exclusions(*table, masks.data(), nQueries, results.data());
+
+    std::vector<jint> outBuf;
+    for (const SolverResult& result : results) {
+        append_result(result, &outBuf);
+    }
+    return to_int_array(env, outBuf);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_scout_routeplanner_solver_NativeSolver_releaseExclusionAnalysisNative(
+    JNIEnv* /* env */, jobject /* thiz */,
+    jlong handle)
+{
+    release_exclusion_analysis((DpTable*)(intptr_t)handle);
+}
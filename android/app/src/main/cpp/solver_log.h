@@ -0,0 +1,20 @@
+#pragma once
+
+// Logging for the solver: logcat on Android, stderr elsewhere, where info
+// messages only appear once set_info_logging(true) has been called.
+
+#if defined(__ANDROID__)
+#include <android/log.h>
+
+#define LOG_TAG "RouteSolver"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+
+extern bool solver_info_logging;
+
+#define LOG_LINE(...) do { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGI(...) do { if (solver_info_logging) LOG_LINE(__VA_ARGS__); } while (0)
+#define LOGE(...) LOG_LINE(__VA_ARGS__)
+#endif
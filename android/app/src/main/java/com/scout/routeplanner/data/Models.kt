@@ -35,7 +35,45 @@ data class RouteConfig(
 data class SolverResult(
     val count: Int,
     val route: List<String>,
-    val finishTime: Float
+    val finishTime: Float,
+    val countBound: Int = count // no route visits more; above count only if the solve stopped early
+)
+
+data class SpeedStep(
+    val speed: Float,
+    val result: SolverResult
+)
+
+/** Progress of a native solve after [layer] of [layers] DP layers (one per checkpoint count). */
+data class SolveProgress(
+    val layer: Int,
+    val layers: Int,
+    val bestCount: Int // most checkpoints of any route found so far that reaches Finish
+)
+
+/** Native work behind a solve; [counters] is null unless the solver was built with SOLVER_COUNTERS. */
+data class SolveStats(
+    val dpPasses: Long,
+    val states: Long,
+    val peakTableBytes: Long,
+    val counters: SolveCounters?
+)
+
+/**
+ * Hot-path counters of a solve. Layer lists are indexed by the number of
+ * checkpoints visited; a rejected leg counts under the first check it fails.
+ */
+data class SolveCounters(
+    val reachedByLayer: List<Long>,
+    val liveByLayer: List<Long>,
+    val transitions: Long,
+    val pastEndTime: Long,
+    val windowClosed: Long,
+    val finishUnreachable: Long,
+    val initMs: Double,
+    val layersMs: Double,
+    val bestScanMs: Double,
+    val reconstructMs: Double
 )
 
 data class RouteLeg(
@@ -3,7 +3,13 @@ package com.scout.routeplanner.solver
 import com.scout.routeplanner.data.DistanceRecord
 import com.scout.routeplanner.data.OpeningsData
 import com.scout.routeplanner.data.RouteConfig
+import com.scout.routeplanner.data.SolveCounters
+import com.scout.routeplanner.data.SolveProgress
+import com.scout.routeplanner.data.SolveStats
 import com.scout.routeplanner.data.SolverResult
+import com.scout.routeplanner.data.SpeedStep
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
 class NativeSolver {
 
@@ -12,92 +18,638 @@ class NativeSolver {
             System.loadLibrary("routesolver")
         }
 
-        private const val ALL_NODES = 19
-        private const val START_IDX = 17
-        private const val FINISH_IDX = 18
+        /** Must match MAX_CP in solver.h. */
+        const val MAX_CHECKPOINTS = 32
+
+        /** Largest problem whose DP table is kept for exclusion analysis (about 85 MB). */
+        const val MAX_ANALYSIS_CHECKPOINTS = 20
+
+        // Fields before the route in a result record, as append_result in solver_jni.cpp writes them
+        private const val RESULT_FIELDS = 4
+    }
+
+    /** How the native DP table stores times; codes match TimeMode in solver.h. */
+    enum class TimeMode(val code: Int) {
+        /** Exact minutes as floats. */
+        FLOAT(0),
+
+        /**
+         * Whole seconds in 16 bits, rounded down: half the memory. Routes are
+         * replayed in floats and the solve falls back to [FLOAT] if one misses
+         * a window, so the count always matches [FLOAT]; a near-tie may still
+         * pick a route that finishes a little later. Exclusion analyses keep
+         * floats.
+         */
+        SECONDS(1),
+
+        /** Solves with both and logs any difference; returns the float result. */
+        VERIFY(2)
+    }
+
+    /** Which native search a solve runs; codes match Engine in solver.h. */
+    enum class Engine(val code: Int) {
+        /** The DP table up to 24 checkpoints, meeting in the middle above that. */
+        AUTO(0),
+
+        /**
+         * Depth-first branch and bound in little memory. Stopped early, it
+         * returns its best route with [SolverResult.countBound] above the count.
+         */
+        BRANCH_AND_BOUND(1),
+
+        /** Route prefixes in order of departure, skipping those another covers; one thread. */
+        LABEL_SETTING(2)
     }
 
-    private external fun solveNative(
-        travelTimeMatrix: FloatArray,
+    private external fun createWorkspaceNative(): Long
+
+    private external fun releaseWorkspaceNative(workspace: Long)
+
+    private external fun prepareSolveNative(workspace: Long, budgetMs: Long, cancelled: Boolean)
+
+    private external fun cancelSolveNative(workspace: Long)
+
+    private external fun solveStoppedNative(workspace: Long): Boolean
+
+    private external fun resetWorkspaceStatsNative(workspace: Long)
+
+    private external fun workspaceStatsNative(workspace: Long): LongArray
+
+    private external fun createSessionNative(
+        distances: FloatArray,
+        heightGains: FloatArray,
         openingsFlat: BooleanArray,
         finishOpenings: BooleanArray,
         slotStarts: IntArray,
-        speed: Float, dwell: Int, naismith: Float,
+        naismith: Float,
         startTime: Int, endTime: Int,
-        nCheckpoints: Int, nSlots: Int
+        nCheckpoints: Int, nSlots: Int,
+        nThreads: Int
+    ): Long
+
+    private external fun releaseSessionNative(session: Long)
+
+    private external fun sessionSolveIntoNative(
+        workspace: Long, session: Long,
+        speed: Float, dwell: Int, excludedMask: Int,
+        timeMode: Int, engine: Int, out: ByteBuffer
+    )
+
+    private external fun sessionSolveSpeedsNative(
+        workspace: Long, session: Long,
+        speeds: FloatArray, dwell: Int, excludedMask: Int,
+        timeMode: Int, engine: Int
     ): IntArray
 
-    fun solve(
+    private external fun sessionSpeedFrontierNative(
+        workspace: Long, session: Long,
+        minSpeed: Float, maxSpeed: Float, minCount: Int,
+        dwell: Int, excludedMask: Int
+    ): IntArray
+
+    private external fun sessionExclusionAnalysisNative(
+        workspace: Long, session: Long,
+        speed: Float, dwell: Int
+    ): Long
+
+    private external fun queryExclusionsNative(handle: Long, excludedMasks: IntArray): IntArray
+
+    private external fun releaseExclusionAnalysisNative(handle: Long)
+
+    // Native DP memory and worker threads reused between solves, 0 until the first one
+    private val workspaceLock = Any()
+    private var workspace = 0L
+
+    // The control of the solve in progress. Taken without the workspace
+    // lock so cancel() never waits for the solve it is stopping.
+    private val cancelLock = Any()
+    private var activeControl: SolveControl? = null
+
+    /**
+     * Stops a solve early and follows its progress. Pass one to a single
+     * solve, frontier or exclusion analysis. After [cancel], from any
+     * thread, or once [budgetMs] has passed, the call returns the best
+     * routes it has found, all of them feasible; a frontier returns the
+     * steps it has finished. [stoppedEarly] then tells the caller.
+     * [onProgress] runs on the solving thread after each layer of the DP.
+     */
+    class SolveControl(
+        val budgetMs: Long = 0, // 0 = no limit
+        val onProgress: ((SolveProgress) -> Unit)? = null
+    ) {
+        @Volatile
+        var isCancelled = false
+            private set
+
+        @Volatile
+        var stoppedEarly = false
+            internal set
+
+        @Volatile
+        internal var solver: NativeSolver? = null
+
+        fun cancel() {
+            isCancelled = true
+            solver?.cancelIfActive(this)
+        }
+    }
+
+    private fun cancelIfActive(control: SolveControl) {
+        synchronized(cancelLock) {
+            if (activeControl === control) cancelSolveNative(workspace)
+        }
+    }
+
+    // Called from solver_jni.cpp after each DP layer, under the workspace lock
+    @Suppress("unused")
+    private fun onSolveProgress(layer: Int, layers: Int, bestCount: Int) {
+        activeControl?.onProgress?.invoke(SolveProgress(layer, layers, bestCount))
+    }
+
+    /**
+     * Runs [block] with the native workspace, one solve at a time, counting
+     * stats afresh and stopping as [control] says.
+     */
+    private inline fun <T> withWorkspace(control: SolveControl?, block: (Long) -> T): T =
+        synchronized(workspaceLock) {
+            if (workspace == 0L) workspace = createWorkspaceNative()
+            resetWorkspaceStatsNative(workspace)
+            // Set before reading isCancelled, so a cancel() racing with this
+            // either sees the control active or is seen here
+            control?.solver = this
+            synchronized(cancelLock) {
+                activeControl = control
+                prepareSolveNative(workspace, control?.budgetMs ?: 0L, control?.isCancelled ?: false)
+            }
+            try {
+                block(workspace)
+            } finally {
+                synchronized(cancelLock) { activeControl = null }
+                control?.stoppedEarly = solveStoppedNative(workspace)
+            }
+        }
+
+    /**
+     * Native work behind the most recent solve, frontier or exclusion
+     * analysis, or null before the first. Exclusion queries are not counted.
+     */
+    fun lastSolveStats(): SolveStats? = synchronized(workspaceLock) {
+        if (workspace == 0L) return null
+        parseStats(workspaceStatsNative(workspace))
+    }
+
+    // Layout matches workspaceStatsNative in solver_jni.cpp
+    private fun parseStats(raw: LongArray): SolveStats {
+        val layers = MAX_CHECKPOINTS + 1
+        val reachedAt = 12
+        val liveAt = reachedAt + layers
+        val counters = if (raw[3] == 0L) null else SolveCounters(
+            reachedByLayer = raw.copyOfRange(reachedAt, reachedAt + layers).toList(),
+            liveByLayer = raw.copyOfRange(liveAt, liveAt + layers).toList(),
+            transitions = raw[4],
+            pastEndTime = raw[5],
+            windowClosed = raw[6],
+            finishUnreachable = raw[7],
+            initMs = raw[8] / 1000.0,
+            layersMs = raw[9] / 1000.0,
+            bestScanMs = raw[10] / 1000.0,
+            reconstructMs = raw[11] / 1000.0
+        )
+        return SolveStats(raw[0], raw[1], raw[2], counters)
+    }
+
+    /**
+     * Frees the native workspace, waiting for any solve using it to finish.
+     * A later solve starts a new one.
+     */
+    fun release() {
+        synchronized(workspaceLock) {
+            if (workspace != 0L) {
+                releaseWorkspaceNative(workspace)
+                workspace = 0L
+            }
+        }
+    }
+
+    /** Native node layout and schedule for one set of included checkpoints. */
+    internal class Problem(
         openingsData: OpeningsData,
-        distances: Map<Pair<String, String>, DistanceRecord>,
-        config: RouteConfig,
-        excludedCheckpoints: Set<String> = emptySet()
-    ): SolverResult {
-        val allNames = openingsData.cpNames
-        val intermediateCps = allNames.filter { it != "Start" && it != "Finish" && it !in excludedCheckpoints }
+        excludedCheckpoints: Set<String>
+    ) {
+        val intermediateCps = openingsData.cpNames.filter {
+            it != "Start" && it != "Finish" && it !in excludedCheckpoints
+        }
         val n = intermediateCps.size
         val nSlots = openingsData.slotStarts.size
 
-        // Build index mappings
-        val cpToIdx = intermediateCps.withIndex().associate { (i, name) -> name to i }
-
-        fun nodeIndex(name: String): Int = when (name) {
-            "Start" -> START_IDX
-            "Finish" -> FINISH_IDX
-            else -> cpToIdx[name] ?: -1
+        init {
+            require(n in 1..MAX_CHECKPOINTS) {
+                "Solver supports 1 to $MAX_CHECKPOINTS checkpoints, got $n"
+            }
         }
 
+        // Node layout: intermediates 0..n-1, then Start (n) and Finish (n+1)
+        val allNodes = n + 2
+        val startIdx = n
+        val finishIdx = n + 1
+
         fun nodeName(idx: Int): String = when (idx) {
-            START_IDX -> "Start"
-            FINISH_IDX -> "Finish"
+            startIdx -> "Start"
+            finishIdx -> "Finish"
             else -> intermediateCps[idx]
         }
 
-        // Build travel time matrix
-        val travelTimeMatrix = FloatArray(ALL_NODES * ALL_NODES) { Float.MAX_VALUE }
-        for (i in 0 until ALL_NODES) {
-            for (j in 0 until ALL_NODES) {
-                if (i == j) continue
-                val fromName = nodeName(i)
-                val toName = nodeName(j)
-                val record = distances[Pair(fromName, toName)] ?: continue
-                val tt = (record.distance / config.speed) * 60f + (record.heightGain / config.naismith)
-                travelTimeMatrix[i * ALL_NODES + j] = tt
+        // Openings flat array (n x nSlots)
+        val openingsFlat = BooleanArray(n * nSlots).also { flat ->
+            for (i in 0 until n) {
+                val slots = openingsData.openings[intermediateCps[i]] ?: continue
+                for (s in 0 until nSlots) {
+                    flat[i * nSlots + s] = if (s < slots.size) slots[s] == 1 else false
+                }
             }
         }
 
-        // Build openings flat array (n x nSlots)
-        val openingsFlat = BooleanArray(n * nSlots)
-        for (i in 0 until n) {
-            val name = intermediateCps[i]
-            val slots = openingsData.openings[name] ?: continue
-            for (s in 0 until nSlots) {
-                openingsFlat[i * nSlots + s] = if (s < slots.size) slots[s] == 1 else false
+        // Finish openings
+        val finishOpenings = run {
+            val finishSlots = openingsData.openings["Finish"] ?: List(nSlots) { 0 }
+            BooleanArray(nSlots) { s -> if (s < finishSlots.size) finishSlots[s] == 1 else false }
+        }
+
+        val slotStarts = openingsData.slotStarts.toIntArray()
+
+        /** Bit k set for each of [excluded] that is intermediate checkpoint k. */
+        fun maskOf(excluded: Set<String>): Int {
+            var mask = 0
+            for (k in 0 until n) {
+                if (intermediateCps[k] in excluded) mask = mask or (1 shl k)
             }
+            return mask
         }
 
-        // Finish openings
-        val finishSlots = openingsData.openings["Finish"] ?: List(nSlots) { 0 }
-        val finishOpenings = BooleanArray(nSlots) { s ->
-            if (s < finishSlots.size) finishSlots[s] == 1 else false
+        /** Calls [visit] with (from, to, record) for every leg that has distance data. */
+        inline fun forEachLeg(
+            distances: Map<Pair<String, String>, DistanceRecord>,
+            visit: (Int, Int, DistanceRecord) -> Unit
+        ) {
+            for (i in 0 until allNodes) {
+                for (j in 0 until allNodes) {
+                    if (i == j) continue
+                    val record = distances[Pair(nodeName(i), nodeName(j))] ?: continue
+                    visit(i, j, record)
+                }
+            }
         }
 
-        val slotStarts = openingsData.slotStarts.toIntArray()
+        /** Parses one [count, count_bound, route_length, finish_time_bits, route...] record at [offset]. */
+        fun parseResult(raw: IntArray, offset: Int): SolverResult {
+            val count = raw[offset]
+            val countBound = raw[offset + 1]
+            val routeLength = raw[offset + 2]
+            val finishTime = Float.fromBits(raw[offset + 3])
+            val route = (0 until routeLength).map { nodeName(raw[offset + RESULT_FIELDS + it]) }
+            return SolverResult(count, route, finishTime, countBound)
+        }
+
+        /** Parses [count] consecutive result records starting at the front of [raw]. */
+        fun parseResults(raw: IntArray, count: Int): List<SolverResult> {
+            val results = ArrayList<SolverResult>(count)
+            var offset = 0
+            repeat(count) {
+                val result = parseResult(raw, offset)
+                results.add(result)
+                offset += RESULT_FIELDS + result.route.size
+            }
+            return results
+        }
+    }
+
+    fun solve(
+        openingsData: OpeningsData,
+        distances: Map<Pair<String, String>, DistanceRecord>,
+        config: RouteConfig,
+        excludedCheckpoints: Set<String> = emptySet(),
+        threads: Int = 0, // DP worker threads, 0 = one per core
+        timeMode: TimeMode = TimeMode.FLOAT,
+        engine: Engine = Engine.AUTO,
+        control: SolveControl? = null
+    ): SolverResult =
+        solveSpeeds(
+            openingsData, distances, config, listOf(config.speed), excludedCheckpoints, threads, timeMode,
+            engine, control
+        )[0]
 
-        // Call native solver
-        val rawResult = solveNative(
-            travelTimeMatrix, openingsFlat, finishOpenings, slotStarts,
-            config.speed, config.dwell, config.naismith,
+    /**
+     * Solves the same problem at each of [speeds] (config.speed is ignored),
+     * sharing one native pass over the DP between up to eight speeds.
+     * Results are in the order of [speeds].
+     */
+    fun solveSpeeds(
+        openingsData: OpeningsData,
+        distances: Map<Pair<String, String>, DistanceRecord>,
+        config: RouteConfig,
+        speeds: List<Float>,
+        excludedCheckpoints: Set<String> = emptySet(),
+        threads: Int = 0, // DP worker threads, 0 = one per core
+        timeMode: TimeMode = TimeMode.FLOAT,
+        engine: Engine = Engine.AUTO,
+        control: SolveControl? = null
+    ): List<SolverResult> =
+        openSession(Problem(openingsData, excludedCheckpoints), distances, config, threads).use {
+            it.solveSpeeds(speeds, config.dwell, 0, timeMode, engine, control)
+        }
+
+    /**
+     * The steps of the checkpoint count as a function of walking speed
+     * between [minSpeed] and [maxSpeed] (config.speed is ignored), highest
+     * count first and stopping below [minCount] checkpoints. Each step holds
+     * the exact lowest speed that reaches its count and the solve at that
+     * speed; a step at [minSpeed] may also be reachable below it.
+     */
+    fun speedFrontier(
+        openingsData: OpeningsData,
+        distances: Map<Pair<String, String>, DistanceRecord>,
+        config: RouteConfig,
+        minSpeed: Float,
+        maxSpeed: Float,
+        minCount: Int = 1,
+        excludedCheckpoints: Set<String> = emptySet(),
+        threads: Int = 0, // DP worker threads, 0 = one per core
+        control: SolveControl? = null
+    ): List<SpeedStep> =
+        openSession(Problem(openingsData, excludedCheckpoints), distances, config, threads).use {
+            it.speedFrontier(minSpeed, maxSpeed, config.dwell, minCount, control = control)
+        }
+
+    /**
+     * A reusable direct buffer that [Session.solveInto] writes one solve
+     * into: the checkpoint count and its bound, the exact finish time and,
+     * for every stop from Start to Finish, its node and its arrival and
+     * departure in minutes from midnight. Solving into it and reading it
+     * allocate nothing. Node indices are the session's: intermediates in
+     * [Session.checkpoints] order, then Start and Finish (see
+     * [Session.nodeName]). Sized for any problem the solver accepts.
+     */
+    class PackedRoute {
+        // Layout matches PACKED_HEADER_FIELDS / PACKED_STOP_FIELDS in solver_jni.cpp
+        internal val buffer: ByteBuffer =
+            ByteBuffer.allocateDirect(HEADER_BYTES + STOP_BYTES * (MAX_CHECKPOINTS + 2))
+                .order(ByteOrder.nativeOrder())
+
+        val count: Int get() = buffer.getInt(0)
+
+        /** Route length plus Start and Finish; 0 if no route was found. */
+        val stopCount: Int get() = buffer.getInt(4)
+
+        val finishTime: Float get() = buffer.getFloat(8)
+
+        /** As [SolverResult.countBound]. */
+        val countBound: Int get() = buffer.getInt(12)
+
+        fun node(stop: Int): Int = buffer.getInt(HEADER_BYTES + stop * STOP_BYTES)
+
+        fun arrival(stop: Int): Float = buffer.getFloat(HEADER_BYTES + stop * STOP_BYTES + 4)
+
+        fun departure(stop: Int): Float = buffer.getFloat(HEADER_BYTES + stop * STOP_BYTES + 8)
+
+        private companion object {
+            const val HEADER_BYTES = 16
+            const val STOP_BYTES = 12
+        }
+    }
+
+    /**
+     * Every checkpoint, leg and the schedule held in native memory, so that
+     * solves which only change speed, dwell or exclusions pass just those
+     * values and no arrays are copied.
+     * Results match the stateless calls with the same settings, with
+     * exclusions given as masks over [checkpoints] (bit k = checkpoint k).
+     * Call [close] to free it.
+     */
+    inner class Session internal constructor(
+        private val problem: Problem,
+        private var handle: Long
+    ) : AutoCloseable {
+
+        /** Intermediate checkpoints in mask bit order. */
+        val checkpoints: List<String> get() = problem.intermediateCps
+
+        /** The exclusion mask for [excluded] checkpoint names. */
+        fun maskOf(excluded: Set<String>): Int = problem.maskOf(excluded)
+
+        /** Name of a node index in a [PackedRoute] from this session. */
+        fun nodeName(idx: Int): String = problem.nodeName(idx)
+
+        // Result buffer for solve(), only touched under the workspace lock
+        private val scratch = PackedRoute()
+
+        /** Best route at [speed] and [dwell] without the checkpoints in [excludedMask]. */
+        fun solve(
+            speed: Float,
+            dwell: Int,
+            excludedMask: Int = 0,
+            timeMode: TimeMode = TimeMode.FLOAT,
+            engine: Engine = Engine.AUTO,
+            control: SolveControl? = null
+        ): SolverResult = synchronized(workspaceLock) {
+            solveInto(speed, dwell, excludedMask, timeMode, scratch, engine, control)
+            val route = (1 until scratch.stopCount - 1).map { problem.nodeName(scratch.node(it)) }
+            SolverResult(scratch.count, route, scratch.finishTime, scratch.countBound)
+        }
+
+        /** As [solve], writing the route and its timeline into [out] without allocating. */
+        fun solveInto(
+            speed: Float,
+            dwell: Int,
+            excludedMask: Int,
+            timeMode: TimeMode,
+            out: PackedRoute,
+            engine: Engine = Engine.AUTO,
+            control: SolveControl? = null
+        ) {
+            withSession(control) { ws, session ->
+                sessionSolveIntoNative(
+                    ws, session, speed, dwell, excludedMask, timeMode.code, engine.code, out.buffer
+                )
+            }
+        }
+
+        /**
+         * Best route at each of [speeds], in order, sharing one native pass
+         * over the DP between up to eight speeds.
+         */
+        fun solveSpeeds(
+            speeds: List<Float>,
+            dwell: Int,
+            excludedMask: Int = 0,
+            timeMode: TimeMode = TimeMode.FLOAT,
+            engine: Engine = Engine.AUTO,
+            control: SolveControl? = null
+        ): List<SolverResult> {
+            require(speeds.isNotEmpty()) { "At least one speed is required" }
+            val rawResult = withSession(control) { ws, session ->
+                sessionSolveSpeedsNative(
+                    ws, session, speeds.toFloatArray(), dwell, excludedMask, timeMode.code, engine.code
+                )
+            }
+
+            // One result record per speed: [count, count_bound, route_length, finish_time_bits, route[0], ...]
+            return problem.parseResults(rawResult, speeds.size)
+        }
+
+        /** As [NativeSolver.speedFrontier], without the checkpoints in [excludedMask]. */
+        fun speedFrontier(
+            minSpeed: Float,
+            maxSpeed: Float,
+            dwell: Int,
+            minCount: Int = 1,
+            excludedMask: Int = 0,
+            control: SolveControl? = null
+        ): List<SpeedStep> {
+            val rawResult = withSession(control) { ws, session ->
+                sessionSpeedFrontierNative(ws, session, minSpeed, maxSpeed, minCount, dwell, excludedMask)
+            }
+
+            // Parse: [n_steps, then per step speed_bits followed by a result record]
+            val steps = ArrayList<SpeedStep>(rawResult[0])
+            var offset = 1
+            repeat(rawResult[0]) {
+                val speed = Float.fromBits(rawResult[offset])
+                val result = problem.parseResult(rawResult, offset + 1)
+                steps.add(SpeedStep(speed, result))
+                offset += 1 + RESULT_FIELDS + result.route.size
+            }
+            return steps
+        }
+
+        /**
+         * Solves over every checkpoint and keeps the table, in floats, for
+         * exclusion queries. If [control] stops it early, answers cover only
+         * the states it reached.
+         */
+        fun analyseExclusions(
+            speed: Float,
+            dwell: Int,
+            control: SolveControl? = null
+        ): ExclusionAnalysis {
+            require(problem.n <= MAX_ANALYSIS_CHECKPOINTS) {
+                "Exclusion analysis supports up to $MAX_ANALYSIS_CHECKPOINTS checkpoints"
+            }
+            val analysis = withSession(control) { ws, session ->
+                sessionExclusionAnalysisNative(ws, session, speed, dwell)
+            }
+            return ExclusionAnalysis(problem, analysis)
+        }
+
+        // Holds the workspace lock, so close() cannot free the session mid-solve
+        private inline fun <T> withSession(control: SolveControl?, block: (Long, Long) -> T): T =
+            withWorkspace(control) { ws ->
+                check(handle != 0L) { "Session already closed" }
+                block(ws, handle)
+            }
+
+        override fun close() {
+            synchronized(workspaceLock) {
+                if (handle != 0L) {
+                    releaseSessionNative(handle)
+                    handle = 0L
+                }
+            }
+        }
+    }
+
+    /** Opens a [Session] over every checkpoint with config's Naismith rate and day. */
+    fun openSession(
+        openingsData: OpeningsData,
+        distances: Map<Pair<String, String>, DistanceRecord>,
+        config: RouteConfig,
+        threads: Int = 0 // DP worker threads, 0 = one per core
+    ): Session = openSession(Problem(openingsData, emptySet()), distances, config, threads)
+
+    private fun openSession(
+        problem: Problem,
+        distances: Map<Pair<String, String>, DistanceRecord>,
+        config: RouteConfig,
+        threads: Int
+    ): Session {
+        // Raw leg data; the native side owns the travel time model
+        val matrixSize = problem.allNodes * problem.allNodes
+        val legDistances = FloatArray(matrixSize) { Float.NaN }
+        val heightGains = FloatArray(matrixSize)
+        problem.forEachLeg(distances) { i, j, record ->
+            legDistances[i * problem.allNodes + j] = record.distance
+            heightGains[i * problem.allNodes + j] = record.heightGain
+        }
+
+        val handle = createSessionNative(
+            legDistances, heightGains,
+            problem.openingsFlat, problem.finishOpenings, problem.slotStarts,
+            config.naismith,
             config.startTime, config.endTime,
-            n, nSlots
+            problem.n, problem.nSlots,
+            threads
         )
+        return Session(problem, handle)
+    }
+
+    /**
+     * A solve over every checkpoint whose DP table stays in native memory,
+     * answering "best route without these checkpoints" for any set in one
+     * pass over the table instead of a new solve. Answers are identical to
+     * [solve] with the same exclusions. Call [close] to free the table.
+     */
+    inner class ExclusionAnalysis internal constructor(
+        private val problem: Problem,
+        private var handle: Long
+    ) : AutoCloseable {
+
+        // Held across each native query and the release, so close() from
+        // another thread waits for a query still reading the table
+        private val handleLock = Any()
+
+        /** Best route with [excluded] checkpoints skipped. */
+        fun best(excluded: Set<String>): SolverResult = query(listOf(problem.maskOf(excluded)))[0]
 
-        // Parse result: [count, route_length, finish_time_x100, route[0], ...]
-        val count = rawResult[0]
-        val routeLength = rawResult[1]
-        val finishTime = rawResult[2] / 100.0f
-        val route = (0 until routeLength).map { nodeName(rawResult[3 + it]) }
+        /** Best route with each checkpoint skipped on its own, keyed by that checkpoint. */
+        fun bestWithoutEach(): Map<String, SolverResult> {
+            val results = query(problem.intermediateCps.indices.map { 1 shl it })
+            return problem.intermediateCps.zip(results).toMap()
+        }
 
-        return SolverResult(count, route, finishTime)
+        private fun query(masks: List<Int>): List<SolverResult> {
+            val rawResult = synchronized(handleLock) {
+                check(handle != 0L) { "Exclusion analysis already closed" }
+                queryExclusionsNative(handle, masks.toIntArray())
+            }
+            return problem.parseResults(rawResult, masks.size)
+        }
+
+        override fun close() {
+            synchronized(handleLock) {
+                if (handle != 0L) {
+                    releaseExclusionAnalysisNative(handle)
+                    handle = 0L
+                }
+            }
+        }
+    }
+
+    /** Whether [analyseExclusions] accepts this problem. */
+    fun canAnalyseExclusions(openingsData: OpeningsData): Boolean =
+        openingsData.cpNames.count { it != "Start" && it != "Finish" } in 1..MAX_ANALYSIS_CHECKPOINTS
+
+    /** Solves over every checkpoint at config.speed and keeps the table for exclusion queries. */
+    fun analyseExclusions(
+        openingsData: OpeningsData,
+        distances: Map<Pair<String, String>, DistanceRecord>,
+        config: RouteConfig,
+        threads: Int = 0, // DP worker threads, 0 = one per core
+        control: SolveControl? = null
+    ): ExclusionAnalysis {
+        require(canAnalyseExclusions(openingsData)) {
+            "Exclusion analysis supports up to $MAX_ANALYSIS_CHECKPOINTS checkpoints"
+        }
+        return openSession(openingsData, distances, config, threads).use { session ->
+            session.analyseExclusions(config.speed, config.dwell, control)
+        }
     }
 }
@@ -14,16 +14,21 @@ import com.scout.routeplanner.data.DistanceRecord
 import com.scout.routeplanner.data.OpeningsData
 import com.scout.routeplanner.data.RouteConfig
 import com.scout.routeplanner.data.RouteLeg
+import com.scout.routeplanner.data.SolveProgress
 import com.scout.routeplanner.data.SolverResult
 import com.scout.routeplanner.solver.NativeSolver
 import com.scout.routeplanner.solver.RouteCardBuilder
+import kotlinx.coroutines.CancellationException
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.ensureActive
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
 import java.text.SimpleDateFormat
 import java.util.Date
 import java.util.Locale
 import java.util.TimeZone
+import kotlin.coroutines.coroutineContext
 
 class SolverViewModel(application: Application) : AndroidViewModel(application) {
 
@@ -146,6 +151,71 @@ class SolverViewModel(application: Application) : AndroidViewModel(application)
 
     private var currentConfig = RouteConfig()
 
+    // Full-problem solve for the loaded files at the last speed and dwell,
+    // so re-solving after toggling checkpoints is a table query
+    private data class AnalysisKey(
+        val openings: OpeningsData,
+        val distances: Map<Pair<String, String>, DistanceRecord>,
+        val config: RouteConfig
+    )
+    private var exclusionAnalysis: NativeSolver.ExclusionAnalysis? = null
+    private var exclusionAnalysisKey: AnalysisKey? = null
+
+    private fun releaseExclusionAnalysis() {
+        exclusionAnalysis?.close()
+        exclusionAnalysis = null
+        exclusionAnalysisKey = null
+    }
+
+    // Native copy of the loaded files, so solves pass only speed, dwell and
+    // exclusions; null if there are more checkpoints than the solver takes
+    private var session: NativeSolver.Session? = null
+
+    private fun session(od: OpeningsData, dist: Map<Pair<String, String>, DistanceRecord>): NativeSolver.Session? {
+        val n = od.cpNames.count { it != "Start" && it != "Finish" }
+        if (n !in 1..NativeSolver.MAX_CHECKPOINTS) return null
+        return session ?: solver.openSession(od, dist, RouteConfig()).also { session = it }
+    }
+
+    private fun releaseSession() {
+        if (solveJob?.isActive == true) _isLoading.value = false
+        cancelSolve()
+        releaseExclusionAnalysis()
+        session?.close()
+        session = null
+    }
+
+    // The solve in progress, stopped natively when a newer one replaces it
+    // or the files it was solving change
+    private var solveJob: Job? = null
+    private var solveControl: NativeSolver.SolveControl? = null
+
+    private fun cancelSolve() {
+        solveControl?.cancel()
+        solveJob?.cancel()
+        solveControl = null
+        solveJob = null
+    }
+
+    private fun startSolve(block: suspend (NativeSolver.SolveControl) -> Unit) {
+        cancelSolve()
+        val control = NativeSolver.SolveControl(onProgress = ::postProgress)
+        solveControl = control
+        solveJob = viewModelScope.launch { block(control) }
+    }
+
+    private fun postProgress(progress: SolveProgress) {
+        _statusText.postValue(
+            "Solving: ${progress.layer} of ${progress.layers} checkpoints, best so far ${progress.bestCount}"
+        )
+    }
+
+    override fun onCleared() {
+        releaseSession()
+        solver.release()
+        super.onCleared()
+    }
+
     fun onNavigatedToResults() {
         _navigateToResults.value = false
     }
@@ -159,6 +229,7 @@ class SolverViewModel(application: Application) : AndroidViewModel(application)
                     inputStream.use { CsvParser.parseOpenings(it) }
                 }
                 _openingsData.value = data
+                releaseSession()
                 clearExclusions()
                 updateStatus()
                 if (persistUri) {
@@ -179,6 +250,7 @@ class SolverViewModel(application: Application) : AndroidViewModel(application)
                     inputStream.use { CsvParser.parseDistances(it) }
                 }
                 _distances.value = data
+                releaseSession()
                 updateStatus()
                 if (persistUri) {
                     savePreference(KEY_DISTANCES_URI, uri.toString())
@@ -271,18 +343,49 @@ class SolverViewModel(application: Application) : AndroidViewModel(application)
         _errorText.value = null
         _modeBSpeed.value = null
         val excluded = _excludedCheckpoints.value ?: emptySet()
+        val config = currentConfig
+        val key = AnalysisKey(od, dist, config)
+        val cached = exclusionAnalysis.takeIf { exclusionAnalysisKey == key }
 
-        viewModelScope.launch {
+        startSolve { control ->
+            // A new analysis until it is cached; closed if this solve is replaced first
+            var fresh: NativeSolver.ExclusionAnalysis? = null
             try {
+                val session = session(od, dist)
                 val result = withContext(Dispatchers.Default) {
-                    solver.solve(od, dist, currentConfig, excluded)
+                    val analysis = cached
+                        ?: if (session != null && solver.canAnalyseExclusions(od)) {
+                            session.analyseExclusions(speed, dwell, control = control).also { fresh = it }
+                        } else null
+                    analysis?.best(excluded)
+                        ?: session?.solve(speed, dwell, session.maskOf(excluded), control = control)
+                        ?: solver.solve(od, dist, config, excluded, control = control)
+                }
+                fresh?.let { analysis ->
+                    // A stopped analysis only covers part of the table
+                    if (control.stoppedEarly) {
+                        analysis.close()
+                    } else {
+                        releaseExclusionAnalysis()
+                        exclusionAnalysis = analysis
+                        exclusionAnalysisKey = key
+                    }
+                    fresh = null
                 }
                 buildRouteCard(result)
                 _solverResult.value = result
                 _isLoading.value = false
+                updateStatus()
                 _navigateToResults.value = true
+            } catch (e: CancellationException) {
+                fresh?.close()
+                throw e
             } catch (e: Exception) {
+                // A replacing solve or a file reload may close the cached
+                // analysis before its query runs; that is a cancellation
+                coroutineContext.ensureActive()
                 _isLoading.value = false
+                updateStatus()
                 _errorText.value = "Solver error: ${e.message}"
             }
         }
@@ -302,30 +405,23 @@ class SolverViewModel(application: Application) : AndroidViewModel(application)
         _isLoading.value = true
         _errorText.value = null
 
-        viewModelScope.launch {
+        startSolve { control ->
             try {
+                val session = session(od, dist)
                 val (bestSpeed, bestResult) = withContext(Dispatchers.Default) {
-                    var lo = 3.0f
-                    var hi = 20.0f
-                    val precision = 0.01f
-                    var foundSpeed: Float? = null
-                    var foundResult: SolverResult? = null
-
-                    while (hi - lo > precision) {
-                        val mid = (lo + hi) / 2f
-                        val config = RouteConfig(speed = mid, dwell = dwell)
-                        val result = solver.solve(od, dist, config, excluded)
-                        if (result.count == targetCount) {
-                            foundSpeed = mid
-                            foundResult = result
-                            hi = mid
-                        } else {
-                            lo = mid
-                        }
-                    }
-                    Pair(foundSpeed, foundResult)
+                    // Exact lowest speed in 3..20 km/h at which every checkpoint fits
+                    val steps = session?.speedFrontier(
+                        3.0f, 20.0f, dwell,
+                        minCount = targetCount, excludedMask = session.maskOf(excluded), control = control
+                    ) ?: solver.speedFrontier(
+                        od, dist, RouteConfig(dwell = dwell), 3.0f, 20.0f,
+                        minCount = targetCount, excludedCheckpoints = excluded, control = control
+                    )
+                    val step = steps.firstOrNull()
+                    Pair(step?.speed, step?.result)
                 }
 
+                updateStatus()
                 if (bestSpeed != null && bestResult != null) {
                     currentConfig = RouteConfig(speed = bestSpeed, dwell = dwell)
                     _modeBSpeed.value = bestSpeed
@@ -337,8 +433,11 @@ class SolverViewModel(application: Application) : AndroidViewModel(application)
                     _isLoading.value = false
                     _errorText.value = "Cannot visit all checkpoints even at 20 km/h"
                 }
+            } catch (e: CancellationException) {
+                throw e
             } catch (e: Exception) {
                 _isLoading.value = false
+                updateStatus()
                 _errorText.value = "Solver error: ${e.message}"
             }
         }